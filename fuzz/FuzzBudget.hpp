@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "stats/AllocationStats.hpp"
+
+// Turns slow inputs into fuzzer findings: an input whose conversion takes
+// longer, or allocates more often, than its size justifies aborts, so
+// libFuzzer saves (and with -minimize_crash=1 shrinks) it like a crash.
+//
+// Budgets are a fixed allowance plus a per-byte rate and can be changed
+// through the environment:
+//   M2H_FUZZ_US_PER_BYTE      (default 20)   M2H_FUZZ_US_BASE      (50000)
+//   M2H_FUZZ_ALLOCS_PER_BYTE  (default 4)    M2H_FUZZ_ALLOCS_BASE  (1000)
+class FuzzBudget {
+ public:
+  FuzzBudget()
+      : start{std::chrono::steady_clock::now()},
+        allocations{m2h::allocationStats().allocations} {}
+
+  void check(const char* target, std::size_t size) const {
+    static const double usPerByte = setting("M2H_FUZZ_US_PER_BYTE", 20);
+    static const double usBase = setting("M2H_FUZZ_US_BASE", 50000);
+    static const double allocsPerByte = setting("M2H_FUZZ_ALLOCS_PER_BYTE", 4);
+    static const double allocsBase = setting("M2H_FUZZ_ALLOCS_BASE", 1000);
+
+    const double us = std::chrono::duration<double, std::micro>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    const std::uint64_t allocs =
+        m2h::allocationStats().allocations - allocations;
+    if (us > usBase + usPerByte * size) {
+      std::fprintf(stderr, "%s: %zu bytes took %.0f us\n", target, size, us);
+      std::abort();
+    }
+    if (allocs > allocsBase + allocsPerByte * size) {
+      std::fprintf(stderr, "%s: %zu bytes made %llu allocations\n", target,
+                   size, static_cast<unsigned long long>(allocs));
+      std::abort();
+    }
+  }
+
+ private:
+  static double setting(const char* name, double fallback) {
+    const char* value = std::getenv(name);
+    return value ? std::atof(value) : fallback;
+  }
+
+  std::chrono::steady_clock::time_point start;
+  std::uint64_t allocations;
+};
@@ -0,0 +1,42 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+// Stand-in for libFuzzer's main where it is not available: runs the
+// target once on every file given, directories are walked recursively.
+// This is also how the perf corpus is replayed.
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data,
+                                      std::size_t size);
+
+static void run(const std::filesystem::path& path) {
+  // printed first so that a budget or sanitizer abort names its input
+  std::fprintf(stderr, "Running: %s\n", path.c_str());
+  std::ifstream ifs(path, std::ios::binary);
+  const std::string input{std::istreambuf_iterator<char>(ifs),
+                          std::istreambuf_iterator<char>()};
+  LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t*>(input.data()),
+                         input.size());
+}
+
+int main(int argc, char* argv[]) {
+  namespace fs = std::filesystem;
+  std::size_t count = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (fs::is_directory(argv[i])) {
+      for (auto&& entry : fs::recursive_directory_iterator(argv[i])) {
+        if (!entry.is_regular_file()) continue;
+        run(entry.path());
+        ++count;
+      }
+    } else {
+      run(argv[i]);
+      ++count;
+    }
+  }
+  std::printf("ran %zu inputs\n", count);
+  return 0;
+}
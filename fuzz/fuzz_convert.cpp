@@ -0,0 +1,75 @@
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FuzzBudget.hpp"
+#include "ast/BinaryAst.hpp"
+#include "document/Document.hpp"
+#include "io/Utf8.hpp"
+#include "parser/DocumentIndex.hpp"
+#include "parser/SectionIndex.hpp"
+#include "render/HtmlRenderer.hpp"
+#include "render/MultiRenderer.hpp"
+#include "render/PlainTextRenderer.hpp"
+#include "render/SummaryRenderer.hpp"
+
+// Check the UTF-8, tokenize, parse, index and render every output of
+// main.bin, then round-trip the tree through the binary AST and scan the
+// sections.
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data,
+                                      std::size_t size) {
+  const std::string input(reinterpret_cast<const char*>(data), size);
+  FuzzBudget budget;
+
+  // checking in chunks, as main.bin reads, gives the text checked at once
+  std::string whole = input, chunked;
+  m2h::sanitizeUtf8(whole, m2h::Utf8Mode::Repair);
+  m2h::Utf8Sink sink(chunked, m2h::Utf8Mode::Repair);
+  sink.append(input.data(), size / 2);
+  sink.append(input.data() + size / 2, size - size / 2);
+  sink.finish();
+  if (chunked != whole ||
+      m2h::findInvalidUtf8(whole.data(), whole.size()) != whole.size()) {
+    __builtin_trap();
+  }
+
+  m2h::DocumentIndex index;
+  auto document = m2h::parseDocument(input, m2h::Limits{}, &index,
+                                     m2h::Utf8Mode::Repair);
+
+  std::ostringstream html, text, summary, json, ast;
+  m2h::RendererFor<m2h::HtmlRenderer> htmlRenderer(html, &document->lines());
+  m2h::RendererFor<m2h::PlainTextRenderer> textRenderer(text);
+  m2h::RendererFor<m2h::SummaryRenderer> summaryRenderer(summary);
+  m2h::MultiRenderer renderers;
+  renderers.attach(&htmlRenderer);
+  renderers.attach(&textRenderer);
+  renderers.attach(&summaryRenderer);
+  document->emit(renderers);
+  renderers.finish();
+  for (auto&& node : document->blocks()) node->print(html, "");
+  for (auto format : {m2h::OutputFormat::Html, m2h::OutputFormat::Text,
+                      m2h::OutputFormat::Summary}) {
+    m2h::RenderOptions options;
+    options.format = format;
+    options.sourcepos = true;
+    document->render(html, options);
+  }
+  index.writeJson(json);
+
+  m2h::writeAst(document->blocks(), ast);
+  const std::string bytes = ast.str();
+  m2h::AstView view(bytes.data(), bytes.size());
+  if (!view.validate()) __builtin_trap();
+
+  document.reset();
+
+  m2h::SectionIndex sections(input.data(), input.size());
+  for (auto&& section : sections.sections()) {
+    if (section.begin >= section.end || section.end > size) __builtin_trap();
+  }
+  budget.check("convert", size);
+  return 0;
+}
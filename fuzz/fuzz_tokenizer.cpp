@@ -0,0 +1,20 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "FuzzBudget.hpp"
+#include "io/Utf8.hpp"
+#include "tokenizer/Tokenizer.hpp"
+
+// The tokenizer takes checked text with its length, as main.bin hands it
+// over, so NUL bytes and invalid UTF-8 are repaired first.
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data,
+                                      std::size_t size) {
+  std::string input(reinterpret_cast<const char*>(data), size);
+  FuzzBudget budget;
+  m2h::sanitizeUtf8(input, m2h::Utf8Mode::Repair);
+  m2h::Tokenizer tokenizer;
+  tokenizer.tokenize(input.c_str(), input.size());
+  budget.check("tokenize", size);
+  return 0;
+}
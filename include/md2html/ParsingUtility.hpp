@@ -55,6 +55,21 @@ std::string escape(const std::string& s) {
   return ret;
 }
 
+std::string escapeJson(const std::string& s) {
+  static const char* hex = "0123456789abcdef";
+  auto ret = std::string{};
+  for (unsigned char c : s) {
+    if (c == '"') ret += "\\\"";
+    else if (c == '\\') ret += "\\\\";
+    else if (c == '\n') ret += "\\n";
+    else if (c == '\r') ret += "\\r";
+    else if (c == '\t') ret += "\\t";
+    else if (c < 0x20) ret += std::string("\\u00") + hex[c >> 4] + hex[c & 0xf];
+    else ret += c;
+  }
+  return ret;
+}
+
 template <class Predicate>
 int skipWhile(const char*& p, Predicate&& pred) {
   int count = 0;
@@ -79,18 +94,18 @@ int skipWs(const char*& p) { return skipWhile(p, isSpace); }
 
 std::string trimLeft(const std::string& s) {
   auto first = s.begin(), last = s.end();
-  while (isSpace(*first) && first != last) {
+  while (first != last && isSpace(*first)) {
     ++first;
   }
   return {first, last};
 }
 
 std::string trimRight(const std::string& s) {
-  auto first = s.begin(), last = first + s.size() - 1;
-  while (isSpace(*last) && first != last) {
+  auto first = s.begin(), last = s.end();
+  while (first != last && isSpace(*(last - 1))) {
     --last;
   }
-  return {first, last + 1};
+  return {first, last};
 }
 
 std::string trim(const std::string& s) { return trimLeft(trimRight(s)); }
@@ -0,0 +1,47 @@
+#pragma once
+
+// Static tracepoints around the conversion stages.
+//
+// Configure with -DMD2HTML_TRACING=ON (needs <sys/sdt.h>, e.g. from
+// systemtap-sdt-dev) to compile them as USDT probes of provider "md2html":
+//
+//   perf probe -x ./main.bin sdt_md2html:parse_end
+//   bpftrace -e 'usdt:./main.bin:md2html:block { @[arg0] = count(); }'
+//
+// A USDT probe is a single nop plus an ELF note, so it costs next to
+// nothing while nobody is attached. In that build the stage entry points
+// marked M2H_STAGE are also kept out of line, so perf call graphs show
+// them instead of one flattened main(). Without the option every probe
+// compiles to nothing and its arguments are not evaluated. The option is
+// experimental: it has not been built against the systemtap headers yet.
+//
+// Probes and their arguments:
+//   document_start  input bytes
+//   document_end    input bytes, top-level nodes
+//   tokenize_start  -
+//   tokenize_end    bytes consumed, tokens
+//   token_batch     bytes consumed, tokens in the batch (streaming only)
+//   parse_start     -
+//   block           top-level node index, byte offset where it ended
+//   parse_end       byte offset of the last step, top-level nodes
+//   render_start    top-level nodes
+//   render_end      top-level nodes
+
+#ifdef MD2HTML_TRACING
+#include <sys/sdt.h>
+#define M2H_TRACE0(name) DTRACE_PROBE(md2html, name)
+#define M2H_TRACE1(name, a) DTRACE_PROBE1(md2html, name, a)
+#define M2H_TRACE2(name, a, b) DTRACE_PROBE2(md2html, name, a, b)
+#define M2H_STAGE __attribute__((noinline))
+#else
+#define M2H_TRACE0(name) \
+  do {                   \
+  } while (0)
+#define M2H_TRACE1(name, a) \
+  do {                      \
+  } while (0)
+#define M2H_TRACE2(name, a, b) \
+  do {                         \
+  } while (0)
+#define M2H_STAGE
+#endif
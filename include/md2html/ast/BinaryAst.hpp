@@ -0,0 +1,253 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../limits/Limits.hpp"
+#include "../parser/Node.hpp"
+
+namespace m2h {
+
+// Position independent, versioned serialization of the parsed tree.
+//
+//   AstHeader | AstNodeRecord[nodeCount] | string pool
+//
+// Nodes are stored breadth first, so the children of every node occupy a
+// contiguous range of records and the top-level nodes are records
+// [0, rootCount). Texts and URLs (links, images) are (offset, length)
+// spans into the string pool.
+// Everything is addressed by offsets, so a file can be mmap()ed and read
+// in place through AstView without deserializing.
+struct AstHeader {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t nodeCount;
+  std::uint32_t rootCount;
+  std::uint64_t stringsOffset;
+  std::uint64_t stringsSize;
+};
+
+struct AstNodeRecord {
+  std::uint8_t type;  // NodeType
+  std::uint8_t reserved[3];
+  std::int32_t value;  // heading / emphasis level, list / paragraph index
+  std::uint32_t firstChild;
+  std::uint32_t childCount;
+  std::uint64_t textOffset;
+  std::uint64_t urlOffset;
+  std::uint32_t textLength;
+  std::uint32_t urlLength;
+};
+
+static_assert(sizeof(AstHeader) == 32, "AstHeader layout");
+static_assert(sizeof(AstNodeRecord) == 40, "AstNodeRecord layout");
+
+constexpr std::uint32_t astVersion = 2;
+
+inline bool isLittleEndian() {
+  const std::uint16_t probe = 1;
+  return *reinterpret_cast<const std::uint8_t*>(&probe) == 1;
+}
+
+// A count or a string length as the u32 field of a record. Throws
+// LimitExceeded rather than writing a file that is corrupt but may still
+// pass AstView::validate().
+inline std::uint32_t astField(std::uint64_t value, LimitKind kind,
+                              std::uint64_t offset) {
+  const std::uint64_t limit = std::numeric_limits<std::uint32_t>::max();
+  if (value > limit) throw LimitExceeded(kind, limit, offset);
+  return static_cast<std::uint32_t>(value);
+}
+
+void writeAst(const std::vector<const Node*>& nodes, std::ostream& ost) {
+  if (!isLittleEndian()) {
+    throw std::runtime_error("binary ast requires a little-endian host");
+  }
+
+  std::vector<const Node*> order(nodes.begin(), nodes.end());
+  std::vector<AstNodeRecord> records;
+  std::string strings;
+
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    const Node* node = order[i];
+    AstNodeRecord record{};
+    record.type = static_cast<std::uint8_t>(node->getType());
+
+    const std::string* text = nullptr;
+    const std::string* url = nullptr;
+    switch (node->getType()) {
+      case NodeType::Heading: {
+        auto heading = static_cast<const HeadingNode*>(node);
+        record.value = heading->level;
+        text = &heading->heading;
+        break;
+      }
+      case NodeType::Paragraph:
+        record.value = static_cast<const ParagraphNode*>(node)->index;
+        break;
+      case NodeType::CodeBlock:
+        text = &static_cast<const CodeBlockNode*>(node)->text;
+        break;
+      case NodeType::Text:
+        text = &static_cast<const TextNode*>(node)->text;
+        break;
+      case NodeType::InlineCode:
+        text = &static_cast<const InlineCodeNode*>(node)->code;
+        break;
+      case NodeType::Emphasis: {
+        auto emphasis = static_cast<const EmphasisNode*>(node);
+        record.value = emphasis->level;
+        text = &emphasis->text;
+        break;
+      }
+      case NodeType::Link: {
+        auto link = static_cast<const LinkNode*>(node);
+        text = &link->text;
+        url = &link->url;
+        break;
+      }
+      case NodeType::Image: {
+        auto image = static_cast<const ImageNode*>(node);
+        text = &image->alt;
+        url = &image->url;
+        break;
+      }
+      case NodeType::OrderedList:
+        record.value = static_cast<const OrderedListNode*>(node)->index;
+        break;
+      case NodeType::UnorderedList:
+        record.value = static_cast<const UnorderedListNode*>(node)->index;
+        break;
+      default:
+        break;
+    }
+    if (text) {
+      record.textOffset = strings.size();
+      record.textLength =
+          astField(text->size(), LimitKind::InputBytes, node->sourceBegin);
+      strings += *text;
+    }
+    if (url) {
+      record.urlOffset = strings.size();
+      record.urlLength =
+          astField(url->size(), LimitKind::InputBytes, node->sourceBegin);
+      strings += *url;
+    }
+
+    // the last child must still have a u32 id
+    astField(order.size() + node->children().size(), LimitKind::Nodes,
+             node->sourceBegin);
+    record.firstChild = static_cast<std::uint32_t>(order.size());
+    record.childCount = static_cast<std::uint32_t>(node->children().size());
+    order.insert(order.end(), node->children().begin(), node->children().end());
+    records.push_back(record);
+  }
+
+  AstHeader header{};
+  std::memcpy(header.magic, "M2HA", 4);
+  header.version = astVersion;
+  header.nodeCount = astField(records.size(), LimitKind::Nodes, 0);
+  header.rootCount = astField(nodes.size(), LimitKind::Nodes, 0);
+  header.stringsOffset =
+      sizeof(AstHeader) + records.size() * sizeof(AstNodeRecord);
+  header.stringsSize = strings.size();
+
+  ost.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  ost.write(reinterpret_cast<const char*>(records.data()),
+            records.size() * sizeof(AstNodeRecord));
+  ost.write(strings.data(), strings.size());
+}
+
+class AstNodeView {
+ public:
+  AstNodeView(const AstNodeRecord* records, const char* strings,
+              std::uint32_t id)
+      : records{records}, strings{strings}, id{id} {}
+
+  NodeType type() const { return static_cast<NodeType>(record().type); }
+  int value() const { return record().value; }
+  std::uint32_t childCount() const { return record().childCount; }
+  AstNodeView child(std::uint32_t i) const {
+    return {records, strings, record().firstChild + i};
+  }
+  std::string_view text() const {
+    return {strings + record().textOffset, record().textLength};
+  }
+  std::string_view url() const {
+    return {strings + record().urlOffset, record().urlLength};
+  }
+
+ private:
+  const AstNodeRecord& record() const { return records[id]; }
+
+  const AstNodeRecord* records;
+  const char* strings;
+  std::uint32_t id;
+};
+
+// Read-only view over a serialized tree, typically a MappedFile. The
+// constructor only checks the header; call validate() once on untrusted
+// input before traversing it.
+class AstView {
+ public:
+  AstView(const char* data, std::size_t size) : data{data}, size{size} {
+    if (!isLittleEndian() || size < sizeof(AstHeader) ||
+        std::memcmp(header().magic, "M2HA", 4) != 0) {
+      throw std::runtime_error("not a binary ast");
+    }
+    if (header().version != astVersion) {
+      throw std::runtime_error("unsupported binary ast version");
+    }
+    const std::uint64_t recordsEnd =
+        sizeof(AstHeader) +
+        std::uint64_t{header().nodeCount} * sizeof(AstNodeRecord);
+    if (header().rootCount > header().nodeCount || recordsEnd > size ||
+        header().stringsOffset != recordsEnd ||
+        header().stringsSize > size - recordsEnd) {
+      throw std::runtime_error("truncated binary ast");
+    }
+  }
+
+  bool validate() const {
+    const std::uint32_t count = header().nodeCount;
+    for (std::uint32_t i = 0; i < count; ++i) {
+      const AstNodeRecord& r = records()[i];
+      if (r.childCount != 0 && (r.firstChild <= i || r.firstChild > count ||
+                                r.childCount > count - r.firstChild)) {
+        return false;
+      }
+      if (r.textOffset > header().stringsSize ||
+          r.textLength > header().stringsSize - r.textOffset ||
+          r.urlOffset > header().stringsSize ||
+          r.urlLength > header().stringsSize - r.urlOffset) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::uint32_t nodeCount() const { return header().nodeCount; }
+  std::uint32_t rootCount() const { return header().rootCount; }
+  AstNodeView root(std::uint32_t i) const { return {records(), strings(), i}; }
+
+ private:
+  const AstHeader& header() const {
+    return *reinterpret_cast<const AstHeader*>(data);
+  }
+  const AstNodeRecord* records() const {
+    return reinterpret_cast<const AstNodeRecord*>(data + sizeof(AstHeader));
+  }
+  const char* strings() const { return data + header().stringsOffset; }
+
+  const char* data;
+  std::size_t size;
+};
+
+}  // namespace m2h
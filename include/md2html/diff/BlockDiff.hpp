@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../ParsingUtility.hpp"
+#include "../hash/Xxh64.hpp"
+#include "../io/LittleEndian.hpp"
+
+namespace m2h {
+
+// Block-level diff between two renders of a document, for live previews
+// that should update only what changed. Every top-level block is known by
+// the XXH64 of its html, rendered without source positions, and by its
+// first line; the blocks of the previous render are kept as these only
+// (readState/writeState), the current ones with their html. The edit
+// script over the hashes comes from Myers' algorithm, so its cost and the
+// patch size follow the edit rather than the document. A block that is
+// kept but starts on another line, as every block after an inserted line
+// does, costs a "lines" operation for its whole run of such blocks
+// instead of its html.
+//
+// The patch is JSON:
+//   {"blocks":N,"ops":[{"op":"reset"},
+//                      {"op":"replace","index":i,"html":"..."},
+//                      {"op":"insert","index":i,"html":"..."},
+//                      {"op":"remove","index":i,"count":c},
+//                      {"op":"lines","index":i,"count":c,"delta":d}]}
+// The operations apply in order, each `index` to the block list as left
+// by the ones before it; N is the number of blocks afterwards. "lines"
+// adds `d` to both line numbers of every data-sourcepos attribute in the
+// `c` blocks from `index` on. "reset" drops every block; it comes first,
+// followed by an insert of each block, when there is no state of the
+// previous render to compare against: none was written yet, it is
+// unreadable or of another version, or it was rendered with source
+// positions and this one without, or the other way round.
+class BlockDiff {
+ public:
+  static constexpr std::uint32_t stateVersion = 3;
+
+  // Edit distances beyond this are not worth a minimal script: the
+  // differing middle is replaced as a whole.
+  static constexpr int maxEdits = 1024;
+
+  // `positions` tells whether the blocks are added with their source
+  // positions, as with --sourcepos.
+  explicit BlockDiff(bool positions = false)
+      : positions{positions},
+        reset{true},
+        previous{},
+        previousLines{},
+        hashes{},
+        lines{},
+        html{} {}
+
+  // Loads the block hashes written by writeState for the previous render.
+  // Without a valid state of the same mode the patch starts with a reset.
+  bool readState(std::istream& ist) {
+    previous.clear();
+    previousLines.clear();
+    reset = true;
+    char magic[4];
+    std::uint32_t version = 0, flags = 0, count = 0;
+    if (!ist.read(magic, 4) || std::string(magic, 4) != "M2HD" ||
+        !readU32(ist, version) || version != stateVersion ||
+        !readU32(ist, flags) || flags != stateFlags() ||
+        !readU32(ist, count)) {
+      return false;
+    }
+    std::vector<std::uint64_t> loaded, loadedLines;
+    for (std::uint32_t i = 0; i < count; ++i) {
+      std::uint64_t hash, line;
+      if (!readU64(ist, hash) || !readU64(ist, line)) return false;
+      loaded.push_back(hash);
+      loadedLines.push_back(line);
+    }
+    previous = std::move(loaded);
+    previousLines = std::move(loadedLines);
+    reset = false;
+    return true;
+  }
+
+  // Layout (little-endian): "M2HD" u32 version u32 flags u32 #blocks
+  // {u64 hash u64 line}..., where flags is 1 with source positions.
+  void writeState(std::ostream& ost) const {
+    ost.write("M2HD", 4);
+    writeU32(ost, stateVersion);
+    writeU32(ost, stateFlags());
+    writeU32(ost, hashes.size());
+    for (std::size_t i = 0; i < hashes.size(); ++i) {
+      writeU64(ost, hashes[i]);
+      writeU64(ost, lines[i]);
+    }
+  }
+
+  // A block whose html holds no source positions.
+  void addBlock(std::string blockHtml) {
+    hashes.push_back(Xxh64::hash(blockHtml.data(), blockHtml.size()));
+    lines.push_back(0);
+    html.push_back(std::move(blockHtml));
+  }
+
+  // A block whose html holds source positions: `content` is the same
+  // block rendered without them and `line` the line it starts on.
+  void addBlock(std::string blockHtml, const std::string& content,
+                std::uint64_t line) {
+    hashes.push_back(Xxh64::hash(content.data(), content.size()));
+    lines.push_back(line);
+    html.push_back(std::move(blockHtml));
+  }
+
+  std::size_t previousBlocks() const { return previous.size(); }
+  std::size_t blocks() const { return hashes.size(); }
+
+  // Writes the patch from the previous to the current render and returns
+  // the number of operations in it.
+  std::size_t writePatch(std::ostream& ost) const {
+    std::size_t ops = 0;
+    auto op = [&](const char* name, std::size_t index) {
+      ost << (ops++ == 0 ? "" : ",") << "{\"op\":\"" << name
+          << "\",\"index\":" << index;
+    };
+    // lines a kept block moved by
+    auto moved = [&](std::size_t now, std::size_t then) {
+      return static_cast<std::int64_t>(lines[now] - previousLines[then]);
+    };
+
+    ost << "{\"blocks\":" << hashes.size() << ",\"ops\":[";
+    if (reset) {
+      ost << "{\"op\":\"reset\"}";
+      ++ops;
+      for (std::size_t index = 0; index < html.size(); ++index) {
+        op("insert", index);
+        ost << ",\"html\":\"" << escapeJson(html[index]) << "\"}";
+      }
+      ost << "]}" << std::endl;
+      return ops;
+    }
+    const std::vector<char> edits = script();
+    std::size_t index = 0;  // in the list being patched
+    std::size_t before = 0;  // in `previous`
+    std::size_t i = 0;
+    while (i < edits.size()) {
+      if (edits[i] == '=') {
+        // kept blocks, in runs that moved by the same number of lines
+        const std::int64_t delta = moved(index, before);
+        std::size_t count = 0;
+        for (; i < edits.size() && edits[i] == '=' &&
+               moved(index + count, before + count) == delta;
+             ++i) {
+          ++count;
+        }
+        if (delta != 0) {
+          op("lines", index);
+          ost << ",\"count\":" << count << ",\"delta\":" << delta << '}';
+        }
+        index += count;
+        before += count;
+        continue;
+      }
+      // a run of removals and insertions at one place, of which as many
+      // as possible become replacements
+      std::size_t removed = 0, inserted = 0;
+      for (; i < edits.size() && edits[i] != '='; ++i) {
+        ++(edits[i] == '-' ? removed : inserted);
+      }
+      before += removed;
+      const std::size_t replaced = std::min(removed, inserted);
+      for (std::size_t k = 0; k < inserted; ++k, ++index) {
+        op(k < replaced ? "replace" : "insert", index);
+        ost << ",\"html\":\"" << escapeJson(html[index]) << "\"}";
+      }
+      if (removed > replaced) {
+        op("remove", index);
+        ost << ",\"count\":" << removed - replaced << '}';
+      }
+    }
+    ost << "]}" << std::endl;
+    return ops;
+  }
+
+ private:
+  std::uint32_t stateFlags() const { return positions ? 1 : 0; }
+
+  // '=' keeps a block, '-' removes one of `previous`, '+' inserts one of
+  // `hashes`, in document order.
+  std::vector<char> script() const {
+    const std::size_t n = previous.size(), m = hashes.size();
+    std::size_t prefix = 0;
+    while (prefix < n && prefix < m && previous[prefix] == hashes[prefix]) {
+      ++prefix;
+    }
+    std::size_t suffix = 0;
+    while (suffix < n - prefix && suffix < m - prefix &&
+           previous[n - 1 - suffix] == hashes[m - 1 - suffix]) {
+      ++suffix;
+    }
+
+    std::vector<char> edits(prefix, '=');
+    const std::vector<char> middle =
+        myers(previous.data() + prefix, static_cast<int>(n - prefix - suffix),
+              hashes.data() + prefix, static_cast<int>(m - prefix - suffix));
+    edits.insert(edits.end(), middle.begin(), middle.end());
+    edits.insert(edits.end(), suffix, '=');
+    return edits;
+  }
+
+  // Shortest edit script from a[0, n) to b[0, m), or all of `a` removed
+  // and all of `b` inserted when that is more than maxEdits away.
+  static std::vector<char> myers(const std::uint64_t* a, int n,
+                                 const std::uint64_t* b, int m) {
+    const int limit = std::min(n + m, maxEdits);
+    const int offset = limit + 1;
+    std::vector<int> v(2 * limit + 3, 0);  // furthest x on diagonal k
+    std::vector<std::vector<int>> trace;   // v over [-d, d] after step d
+    int found = -1;
+    for (int d = 0; d <= limit && found < 0; ++d) {
+      for (int k = -d; k <= d; k += 2) {
+        int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+                    ? v[offset + k + 1]
+                    : v[offset + k - 1] + 1;
+        int y = x - k;
+        while (x < n && y < m && a[x] == b[y]) ++x, ++y;
+        v[offset + k] = x;
+        if (x >= n && y >= m) found = d;
+      }
+      trace.emplace_back(v.begin() + offset - d, v.begin() + offset + d + 1);
+    }
+
+    std::vector<char> edits;
+    if (found < 0) {
+      edits.assign(n, '-');
+      edits.insert(edits.end(), m, '+');
+      return edits;
+    }
+    int x = n, y = m;
+    for (int d = found; d > 0; --d) {
+      const std::vector<int>& before = trace[d - 1];
+      auto at = [&](int k) { return before[k + d - 1]; };
+      const int k = x - y;
+      const bool down = k == -d || (k != d && at(k - 1) < at(k + 1));
+      const int prevK = down ? k + 1 : k - 1;
+      const int prevX = at(prevK), prevY = prevX - prevK;
+      while (x > prevX && y > prevY) {
+        edits.push_back('=');
+        --x, --y;
+      }
+      edits.push_back(down ? '+' : '-');
+      x = prevX;
+      y = prevY;
+    }
+    edits.insert(edits.end(), x, '=');
+    std::reverse(edits.begin(), edits.end());
+    return edits;
+  }
+
+  bool positions;
+  bool reset;  // no previous render to compare against
+  std::vector<std::uint64_t> previous;
+  std::vector<std::uint64_t> previousLines;
+  std::vector<std::uint64_t> hashes;
+  std::vector<std::uint64_t> lines;  // first line of each block, or 0
+  std::vector<std::string> html;
+};
+
+}  // namespace m2h
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../io/Utf8.hpp"
+#include "../limits/Limits.hpp"
+#include "../parser/DocumentIndex.hpp"
+#include "../parser/EventParser.hpp"
+#include "../parser/LineIndex.hpp"
+#include "../parser/Node.hpp"
+#include "../parser/Parser.hpp"
+#include "../render/HtmlRenderer.hpp"
+#include "../render/PlainTextRenderer.hpp"
+#include "../render/SummaryRenderer.hpp"
+#include "../tokenizer/Tokenizer.hpp"
+
+namespace m2h {
+
+enum class OutputFormat { Html, Text, Summary };
+
+struct RenderOptions {
+  OutputFormat format = OutputFormat::Html;
+  bool sourcepos = false;           // html: data-sourcepos on every block
+  std::size_t summaryLength = 200;  // summary: characters kept
+};
+
+// Frees the block trees it holds; keeps parsed blocks from leaking on
+// their way into a Document when something throws.
+struct BlocksDeleter {
+  void operator()(std::vector<Node*>* blocks) const {
+    for (auto&& node : *blocks) destroyTree(node);
+    delete blocks;
+  }
+};
+
+using OwnedBlocks = std::unique_ptr<std::vector<Node*>, BlocksDeleter>;
+
+// A parsed document that no longer changes. It owns its source text and
+// its block trees, and reading or rendering it writes nothing shared:
+// every render brings its own renderer and the LineIndex behind
+// data-sourcepos is built once. A std::shared_ptr<const Document> can
+// therefore be cached and rendered from any number of threads at once,
+// each with its own RenderOptions, without locking.
+class Document {
+ public:
+  // Takes over `blocks`, the top-level nodes parsed from `source`; they
+  // stay with `blocks` until construction has succeeded.
+  Document(std::string source, OwnedBlocks blocks)
+      : text{std::move(source)},
+        nodes(blocks->begin(), blocks->end()),
+        lineIndex{text.data(), text.size()} {
+    blocks->clear();
+  }
+
+  Document(const Document&) = delete;
+  Document& operator=(const Document&) = delete;
+
+  ~Document() {
+    for (auto&& node : nodes) destroyTree(node);
+  }
+
+  const std::string& source() const { return text; }
+  const std::vector<const Node*>& blocks() const { return nodes; }
+  const LineIndex& lines() const { return lineIndex; }
+
+  // Reports every block to `handler`, see emitEvents.
+  template <class Handler>
+  void emit(Handler& handler) const {
+    for (auto&& node : nodes) emitEvents(node, handler);
+  }
+
+  void render(std::ostream& ost,
+              const RenderOptions& options = RenderOptions{}) const {
+    switch (options.format) {
+      case OutputFormat::Html: {
+        HtmlRenderer html(ost, options.sourcepos ? &lineIndex : nullptr);
+        emit(html);
+        break;
+      }
+      case OutputFormat::Text: {
+        PlainTextRenderer plain(ost);
+        emit(plain);
+        break;
+      }
+      case OutputFormat::Summary: {
+        SummaryRenderer summary(ost, options.summaryLength);
+        emit(summary);
+        summary.finish();
+        break;
+      }
+    }
+  }
+
+ private:
+  std::string text;
+  std::vector<const Node*> nodes;
+  LineIndex lineIndex;
+};
+
+// Checks, tokenizes and parses `source` into a Document. Tokenizer and
+// parser are local to the call, so documents can be parsed on several
+// threads as well. Throws LimitExceeded when `source` breaks `limits`, and
+// InvalidInput for bad UTF-8 or NUL in Utf8Mode::Reject.
+inline std::shared_ptr<const Document> parseDocument(
+    std::string source, const Limits& limits = Limits{},
+    DocumentIndex* index = nullptr, Utf8Mode utf8 = Utf8Mode::Reject) {
+  LimitChecker(limits).checkInput(source.size());
+  sanitizeUtf8(source, utf8);
+  Tokenizer tokenizer(limits);
+  std::vector<Token> tokens =
+      tokenizer.tokenize(source.c_str(), source.size());
+  Parser parser(index, limits);
+  OwnedBlocks blocks(new std::vector<Node*>());
+  *blocks = parser.parse(tokens);
+  return std::make_shared<const Document>(std::move(source),
+                                          std::move(blocks));
+}
+
+}  // namespace m2h
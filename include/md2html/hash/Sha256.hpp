@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace m2h {
+
+// Streaming SHA-256 (FIPS 180-4). Like Xxh64, update() may be called with
+// any split of the input.
+class Sha256 {
+ public:
+  using Digest = std::array<std::uint8_t, 32>;
+
+  Sha256() { reset(); }
+
+  void reset() {
+    static const std::uint32_t init[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    std::memcpy(state, init, sizeof(state));
+    total = 0;
+    buffered = 0;
+  }
+
+  void update(const void* data, std::size_t size) {
+    auto p = static_cast<const unsigned char*>(data);
+    total += size;
+    if (buffered > 0) {
+      const std::size_t fill = std::min<std::size_t>(64 - buffered, size);
+      std::memcpy(buffer + buffered, p, fill);
+      buffered += fill;
+      p += fill;
+      size -= fill;
+      if (buffered < 64) return;
+      consume(buffer);
+      buffered = 0;
+    }
+    while (size >= 64) {
+      consume(p);
+      p += 64;
+      size -= 64;
+    }
+    std::memcpy(buffer, p, size);
+    buffered = size;
+  }
+
+  void update(const std::string& s) { update(s.data(), s.size()); }
+
+  // Digest of everything passed to update() so far; the state is kept, so
+  // hashing may go on afterwards.
+  Digest digest() const {
+    Sha256 h = *this;
+    const std::uint64_t bits = total * 8;
+    const unsigned char pad = 0x80;
+    h.update(&pad, 1);
+    const unsigned char zero[64] = {};
+    h.update(zero, (h.buffered <= 56 ? 56 : 120) - h.buffered);
+    unsigned char length[8];
+    for (int i = 0; i < 8; ++i) length[i] = bits >> (56 - 8 * i);
+    h.update(length, 8);
+
+    Digest out;
+    for (int i = 0; i < 8; ++i) {
+      for (int j = 0; j < 4; ++j) out[4 * i + j] = h.state[i] >> (24 - 8 * j);
+    }
+    return out;
+  }
+
+  std::string hexDigest() const {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (std::uint8_t b : digest()) {
+      hex += digits[b >> 4];
+      hex += digits[b & 15];
+    }
+    return hex;
+  }
+
+ private:
+  static std::uint32_t rotr(std::uint32_t x, int r) {
+    return (x >> r) | (x << (32 - r));
+  }
+
+  void consume(const unsigned char* p) {
+    static const std::uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+        0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+        0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+        0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+        0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+        0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+        0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+        0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+    std::uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+      w[i] = std::uint32_t{p[4 * i]} << 24 | std::uint32_t{p[4 * i + 1]} << 16 |
+             std::uint32_t{p[4 * i + 2]} << 8 | std::uint32_t{p[4 * i + 3]};
+    }
+    for (int i = 16; i < 64; ++i) {
+      const std::uint32_t s0 =
+          rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      const std::uint32_t s1 =
+          rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    std::uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+      const std::uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+      const std::uint32_t ch = (e & f) ^ (~e & g);
+      const std::uint32_t t1 = h + s1 + ch + k[i] + w[i];
+      const std::uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+      const std::uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+      const std::uint32_t t2 = s0 + maj;
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+
+  std::uint32_t state[8];
+  std::uint64_t total;
+  unsigned char buffer[64];
+  std::size_t buffered;
+};
+
+}  // namespace m2h
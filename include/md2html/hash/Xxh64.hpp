@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace m2h {
+
+// Streaming XXH64 (https://github.com/Cyan4973/xxHash), a fast
+// non-cryptographic 64-bit hash. Feeding the same bytes in any split over
+// update() calls gives the same digest as hashing them at once.
+class Xxh64 {
+ public:
+  explicit Xxh64(std::uint64_t seed = 0) { reset(seed); }
+
+  void reset(std::uint64_t seed = 0) {
+    this->seed = seed;
+    v[0] = seed + prime1 + prime2;
+    v[1] = seed + prime2;
+    v[2] = seed;
+    v[3] = seed - prime1;
+    total = 0;
+    buffered = 0;
+  }
+
+  void update(const void* data, std::size_t size) {
+    auto p = static_cast<const unsigned char*>(data);
+    total += size;
+
+    if (buffered + size < 32) {
+      std::memcpy(buffer + buffered, p, size);
+      buffered += size;
+      return;
+    }
+    if (buffered > 0) {
+      const std::size_t fill = 32 - buffered;
+      std::memcpy(buffer + buffered, p, fill);
+      consume(buffer);
+      p += fill;
+      size -= fill;
+      buffered = 0;
+    }
+    while (size >= 32) {
+      consume(p);
+      p += 32;
+      size -= 32;
+    }
+    std::memcpy(buffer, p, size);
+    buffered = size;
+  }
+
+  void update(const std::string& s) { update(s.data(), s.size()); }
+
+  std::uint64_t digest() const {
+    std::uint64_t h;
+    if (total >= 32) {
+      h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+      for (int i = 0; i < 4; ++i) h = mergeRound(h, v[i]);
+    } else {
+      h = seed + prime5;
+    }
+    h += total;
+
+    const unsigned char* p = buffer;
+    std::size_t size = buffered;
+    while (size >= 8) {
+      h ^= round(0, read64(p));
+      h = rotl(h, 27) * prime1 + prime4;
+      p += 8;
+      size -= 8;
+    }
+    if (size >= 4) {
+      h ^= std::uint64_t{read32(p)} * prime1;
+      h = rotl(h, 23) * prime2 + prime3;
+      p += 4;
+      size -= 4;
+    }
+    while (size > 0) {
+      h ^= *p * prime5;
+      h = rotl(h, 11) * prime1;
+      ++p;
+      --size;
+    }
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+  }
+
+  static std::uint64_t hash(const void* data, std::size_t size,
+                            std::uint64_t seed = 0) {
+    Xxh64 h(seed);
+    h.update(data, size);
+    return h.digest();
+  }
+
+ private:
+  static constexpr std::uint64_t prime1 = 11400714785074694791ULL;
+  static constexpr std::uint64_t prime2 = 14029467366897019727ULL;
+  static constexpr std::uint64_t prime3 = 1609587929392839161ULL;
+  static constexpr std::uint64_t prime4 = 9650029242287828579ULL;
+  static constexpr std::uint64_t prime5 = 2870177450012600261ULL;
+
+  static std::uint64_t rotl(std::uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+  }
+
+  // little-endian loads, independent of the host byte order
+  static std::uint64_t read64(const unsigned char* p) {
+    std::uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+  }
+
+  static std::uint32_t read32(const unsigned char* p) {
+    std::uint32_t v = 0;
+    for (int i = 3; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+  }
+
+  static std::uint64_t round(std::uint64_t acc, std::uint64_t input) {
+    acc += input * prime2;
+    acc = rotl(acc, 31);
+    return acc * prime1;
+  }
+
+  static std::uint64_t mergeRound(std::uint64_t acc, std::uint64_t val) {
+    acc ^= round(0, val);
+    return acc * prime1 + prime4;
+  }
+
+  void consume(const unsigned char* p) {
+    for (int i = 0; i < 4; ++i) v[i] = round(v[i], read64(p + 8 * i));
+  }
+
+  std::uint64_t seed;
+  std::uint64_t v[4];
+  std::uint64_t total;
+  unsigned char buffer[32];
+  std::size_t buffered;
+};
+
+}  // namespace m2h
@@ -0,0 +1,547 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IoUring.hpp"
+
+namespace m2h {
+
+struct BatchJob {
+  std::string input;
+  std::string output;
+};
+
+struct BatchStats {
+  const char* backend = "";
+  std::size_t files = 0;
+  std::size_t failed = 0;
+  std::uint64_t bytesIn = 0;
+  std::uint64_t bytesOut = 0;
+  std::uint64_t syscalls = 0;
+  double seconds = 0;
+};
+
+// May throw (e.g. LimitExceeded) to reject a document; the file then
+// counts as failed and the batch goes on.
+using ConvertFunction = std::function<std::string(const std::string&)>;
+
+// `input` below `inputDir` is converted to the same relative path with an
+// .html extension below `outputDir`.
+std::string outputPathFor(const std::string& input, const std::string& inputDir,
+                          const std::string& outputDir) {
+  namespace fs = std::filesystem;
+  fs::path output = fs::path(outputDir) / fs::relative(input, inputDir);
+  output.replace_extension(".html");
+  return output.string();
+}
+
+// Every *.md below `inputDir` becomes a job. Output directories are created
+// here, up front, so the backends only deal with file contents.
+std::vector<BatchJob> collectJobs(const std::string& inputDir,
+                                  const std::string& outputDir) {
+  namespace fs = std::filesystem;
+  std::vector<BatchJob> jobs;
+  for (auto&& entry : fs::recursive_directory_iterator(inputDir)) {
+    if (!entry.is_regular_file() || entry.path().extension() != ".md") {
+      continue;
+    }
+    auto output = outputPathFor(entry.path().string(), inputDir, outputDir);
+    fs::create_directories(fs::path(output).parent_path());
+    jobs.push_back({entry.path().string(), output});
+  }
+  std::sort(jobs.begin(), jobs.end(),
+            [](const BatchJob& a, const BatchJob& b) { return a.input < b.input; });
+  return jobs;
+}
+
+// Blocking backend: `threads` workers each run open/fstat/read/close,
+// convert, open/write/close for one file at a time.
+BatchStats convertWithThreads(const std::vector<BatchJob>& jobs,
+                              const ConvertFunction& convert,
+                              unsigned threads) {
+  const auto start = std::chrono::steady_clock::now();
+  std::atomic<std::size_t> next{0};
+  std::atomic<std::size_t> failed{0};
+  std::atomic<std::uint64_t> bytesIn{0}, bytesOut{0}, syscalls{0};
+
+  auto worker = [&] {
+    std::uint64_t calls = 0, in = 0, out = 0;
+    for (std::size_t i = next++; i < jobs.size(); i = next++) {
+      auto&& job = jobs[i];
+      bool ok = false;
+      std::string source;
+      int fd = ::open(job.input.c_str(), O_RDONLY | O_CLOEXEC);
+      ++calls;
+      struct stat st;
+      if (fd >= 0 && (++calls, ::fstat(fd, &st) == 0)) {
+        source.resize(static_cast<std::size_t>(st.st_size));
+        std::size_t done = 0;
+        ssize_t n = 1;
+        while (done < source.size() && n > 0) {
+          n = ::read(fd, &source[done], source.size() - done);
+          ++calls;
+          if (n > 0) done += static_cast<std::size_t>(n);
+        }
+        source.resize(done);
+        ok = n >= 0;
+      }
+      if (fd >= 0) {
+        ::close(fd);
+        ++calls;
+      }
+      std::string html;
+      std::string error;
+      if (ok) {
+        in += source.size();
+        try {
+          html = convert(source);
+        } catch (const std::exception& e) {
+          ok = false;
+          error = e.what();
+        }
+      }
+      if (ok) {
+        fd = ::open(job.output.c_str(),
+                    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        ++calls;
+        ok = fd >= 0;
+        std::size_t done = 0;
+        while (ok && done < html.size()) {
+          const ssize_t n = ::write(fd, html.data() + done, html.size() - done);
+          ++calls;
+          ok = n > 0;
+          if (ok) done += static_cast<std::size_t>(n);
+        }
+        if (fd >= 0) {
+          ::close(fd);
+          ++calls;
+        }
+        out += done;
+      }
+      if (!ok) {
+        ++failed;
+        std::cerr << "failed to convert: '" << job.input << "'"
+                  << (error.empty() ? "" : ": " + error) << std::endl;
+      }
+    }
+    syscalls += calls;
+    bytesIn += in;
+    bytesOut += out;
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < std::max(threads, 1u); ++i) pool.emplace_back(worker);
+  for (auto&& t : pool) t.join();
+
+  BatchStats stats;
+  stats.backend = "threads";
+  stats.files = jobs.size();
+  stats.failed = failed;
+  stats.bytesIn = bytesIn;
+  stats.bytesOut = bytesOut;
+  stats.syscalls = syscalls;
+  stats.seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start).count();
+  return stats;
+}
+
+// io_uring backend: up to `inFlight` files progress through
+//   statx -> openat -> read... -> close, convert, openat -> write... -> close
+// as a state machine. The ring thread only does the I/O: all operations
+// queued while handling a round of completions go to the kernel in a
+// single io_uring_enter. Conversions run on `threads` workers, which
+// report back through an eventfd the ring keeps a read queued on, so the
+// same io_uring_enter also waits for them. Without workers (or without an
+// eventfd) documents are converted on the ring thread.
+class UringBatch {
+ public:
+  UringBatch(IoUring& ring, const std::vector<BatchJob>& jobs,
+             const ConvertFunction& convert, std::size_t inFlight,
+             unsigned threads = 0)
+      : ring{ring}, jobs{jobs}, convert{convert},
+        slots(std::max<std::size_t>(inFlight, 1)), next{0}, active{0},
+        pendingCloses{0}, stats{}, threads{threads}, workers{}, mutex{},
+        wakeWorkers{}, workersDone{}, toConvert{}, converting{0},
+        converted{}, stopping{false}, wakeFd{-1}, wakeCount{0},
+        wakeArmed{false}, wakeups{0} {}
+
+  BatchStats run() {
+    const auto start = std::chrono::steady_clock::now();
+    const std::uint64_t callsBefore = ring.syscalls();
+    stats.backend = "io_uring";
+    stats.files = jobs.size();
+
+    if (threads > 0) wakeFd = ::eventfd(0, EFD_CLOEXEC);
+    if (wakeFd >= 0) {
+      for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back([this] { work(); });
+      }
+      armWake();
+    }
+    for (std::size_t i = 0; i < slots.size(); ++i) startNext(i);
+    while (active > 0 || pendingCloses > 0) {
+      if (ring.submitAndWait(1) < 0) {
+        if (errno == EINTR) continue;
+        break;
+      }
+      io_uring_cqe cqe;
+      while (ring.peek(cqe)) complete(cqe);
+    }
+    if (active > 0 || next < jobs.size()) {
+      std::cerr << "io_uring failed: " << std::strerror(errno) << std::endl;
+      stats.failed += jobs.size() - next + active;
+    }
+    stopWorkers();
+
+    stats.syscalls = ring.syscalls() - callsBefore + wakeups;
+    stats.seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start).count();
+    return stats;
+  }
+
+ private:
+  enum class State { Statx, OpenIn, Read, Convert, OpenOut, Write };
+
+  static constexpr std::uint64_t closeTag = ~std::uint64_t{0};
+  static constexpr std::uint64_t wakeTag = ~std::uint64_t{0} - 1;
+
+  struct Slot {
+    std::size_t job = 0;
+    State state = State::Statx;
+    int fd = -1;
+    struct statx stx;
+    std::string source;
+    std::string html;
+    std::string error;  // set by a conversion that threw
+    bool failed = false;
+    std::size_t done = 0;
+  };
+
+  // A free submission entry, submitting the queued ones first if there
+  // is none; nullptr if that submission failed.
+  io_uring_sqe* sqe() {
+    io_uring_sqe* e = ring.getSqe();
+    if (!e && ring.submitAndWait(0) >= 0) e = ring.getSqe();
+    return e;
+  }
+
+  void startNext(std::size_t index) {
+    if (next >= jobs.size()) return;
+    io_uring_sqe* e = sqe();
+    if (!e) return;  // run() counts the jobs never started as failed
+    Slot& slot = slots[index];
+    slot = Slot{};
+    slot.job = next++;
+    ++active;
+    e->opcode = IORING_OP_STATX;
+    e->fd = AT_FDCWD;
+    e->addr = reinterpret_cast<std::uintptr_t>(jobs[slot.job].input.c_str());
+    e->len = STATX_SIZE;
+    e->off = reinterpret_cast<std::uintptr_t>(&slot.stx);
+    e->user_data = index;
+  }
+
+  bool open(std::size_t index, const std::string& path, int flags) {
+    io_uring_sqe* e = sqe();
+    if (!e) return false;
+    e->opcode = IORING_OP_OPENAT;
+    e->fd = AT_FDCWD;
+    e->addr = reinterpret_cast<std::uintptr_t>(path.c_str());
+    e->open_flags = static_cast<std::uint32_t>(flags | O_CLOEXEC);
+    e->len = 0644;
+    e->user_data = index;
+    return true;
+  }
+
+  bool transfer(std::size_t index, std::uint8_t opcode, char* data,
+                std::size_t size) {
+    Slot& slot = slots[index];
+    io_uring_sqe* e = sqe();
+    if (!e) return false;
+    e->opcode = opcode;
+    e->fd = slot.fd;
+    e->addr = reinterpret_cast<std::uintptr_t>(data + slot.done);
+    e->len = static_cast<std::uint32_t>(
+        std::min<std::size_t>(size - slot.done, 1u << 30));
+    e->off = slot.done;
+    e->user_data = index;
+    return true;
+  }
+
+  void close(int fd) {
+    io_uring_sqe* e = sqe();
+    if (!e) {
+      ::close(fd);
+      return;
+    }
+    e->opcode = IORING_OP_CLOSE;
+    e->fd = fd;
+    e->user_data = closeTag;
+    ++pendingCloses;
+  }
+
+  // Queues a read of the eventfd the workers write after a conversion.
+  // Without it nothing would notice a conversion finishing, so if there
+  // is no entry for it the ring thread waits for the workers instead and
+  // converts the documents read from then on itself.
+  void armWake() {
+    io_uring_sqe* e = sqe();
+    if (!e) {
+      takeConvertedFromWorkers();
+      return;
+    }
+    e->opcode = IORING_OP_READ;
+    e->fd = wakeFd;
+    e->addr = reinterpret_cast<std::uintptr_t>(&wakeCount);
+    e->len = sizeof(wakeCount);
+    e->user_data = wakeTag;
+    wakeArmed = true;
+  }
+
+  void finish(std::size_t index, bool ok, const std::string& error = "") {
+    Slot& slot = slots[index];
+    if (slot.fd >= 0) close(slot.fd);
+    slot.fd = -1;
+    if (!ok) {
+      ++stats.failed;
+      std::cerr << "failed to convert: '" << jobs[slot.job].input << "'"
+                << (error.empty() ? "" : ": " + error) << std::endl;
+    }
+    --active;
+    startNext(index);
+  }
+
+  void convertSlot(Slot& slot) {
+    try {
+      slot.html = convert(slot.source);
+    } catch (const std::exception& e) {
+      slot.failed = true;
+      slot.error = e.what();
+    }
+    slot.source = std::string{};
+  }
+
+  // The input is read; hands it to a worker, or converts it right away.
+  void startConversion(std::size_t index) {
+    Slot& slot = slots[index];
+    close(slot.fd);
+    slot.fd = -1;
+    stats.bytesIn += slot.source.size();
+    slot.state = State::Convert;
+    if (!wakeArmed) {
+      convertSlot(slot);
+      openOutput(index);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      toConvert.push_back(index);
+    }
+    wakeWorkers.notify_one();
+  }
+
+  void openOutput(std::size_t index) {
+    Slot& slot = slots[index];
+    if (slot.failed) {
+      finish(index, false, slot.error);
+      return;
+    }
+    slot.done = 0;
+    slot.state = State::OpenOut;
+    if (!open(index, jobs[slot.job].output, O_WRONLY | O_CREAT | O_TRUNC)) {
+      finish(index, false, "io_uring submission failed");
+    }
+  }
+
+  void work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wakeWorkers.wait(lock, [&] { return stopping || !toConvert.empty(); });
+      if (toConvert.empty()) return;
+      const std::size_t index = toConvert.front();
+      toConvert.pop_front();
+      ++converting;
+      lock.unlock();
+      convertSlot(slots[index]);
+      lock.lock();
+      --converting;
+      converted.push_back(index);
+      ++wakeups;
+      ::eventfd_write(wakeFd, 1);
+      workersDone.notify_all();
+    }
+  }
+
+  // Conversions finished since the last wakeup go on to their output.
+  void takeConverted() {
+    std::vector<std::size_t> done;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      done.swap(converted);
+    }
+    for (auto index : done) openOutput(index);
+  }
+
+  // Called with no eventfd read queued: takes back the documents no
+  // worker has started, waits for the ones being converted and sends all
+  // of them on to their output.
+  void takeConvertedFromWorkers() {
+    std::deque<std::size_t> waiting;
+    std::vector<std::size_t> done;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      waiting.swap(toConvert);
+      workersDone.wait(lock, [&] { return converting == 0; });
+      done.swap(converted);
+    }
+    for (auto index : waiting) convertSlot(slots[index]);
+    done.insert(done.end(), waiting.begin(), waiting.end());
+    for (auto index : done) openOutput(index);
+  }
+
+  void stopWorkers() {
+    if (wakeFd < 0) return;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wakeWorkers.notify_all();
+    for (auto&& worker : workers) worker.join();
+    if (wakeArmed) {
+      // complete the queued read before its buffer goes away
+      ::eventfd_write(wakeFd, 1);
+      io_uring_cqe cqe;
+      while (wakeArmed) {
+        if (ring.submitAndWait(1) < 0) {
+          if (errno == EINTR) continue;
+          std::cerr << "io_uring failed: " << std::strerror(errno)
+                    << std::endl;
+          break;
+        }
+        while (ring.peek(cqe)) {
+          if (cqe.user_data == wakeTag) wakeArmed = false;
+        }
+      }
+    }
+    ::close(wakeFd);
+  }
+
+  void complete(const io_uring_cqe& cqe) {
+    if (cqe.user_data == closeTag) {
+      --pendingCloses;
+      return;
+    }
+    if (cqe.user_data == wakeTag) {
+      wakeArmed = false;
+      takeConverted();
+      armWake();
+      return;
+    }
+    const std::size_t index = static_cast<std::size_t>(cqe.user_data);
+    Slot& slot = slots[index];
+    if (cqe.res < 0) {
+      finish(index, false);
+      return;
+    }
+    bool queued = true;
+    switch (slot.state) {
+      case State::Statx:
+        slot.source.resize(static_cast<std::size_t>(slot.stx.stx_size));
+        slot.state = State::OpenIn;
+        queued = open(index, jobs[slot.job].input, O_RDONLY);
+        break;
+      case State::OpenIn:
+        slot.fd = cqe.res;
+        slot.state = State::Read;
+        if (slot.source.empty()) {
+          startConversion(index);
+          break;
+        }
+        queued = transfer(index, IORING_OP_READ, &slot.source[0],
+                          slot.source.size());
+        break;
+      case State::Read:
+        slot.done += static_cast<std::size_t>(cqe.res);
+        if (cqe.res > 0 && slot.done < slot.source.size()) {
+          queued = transfer(index, IORING_OP_READ, &slot.source[0],
+                            slot.source.size());
+          break;
+        }
+        slot.source.resize(slot.done);
+        startConversion(index);
+        break;
+      case State::Convert:
+        break;
+      case State::OpenOut:
+        slot.fd = cqe.res;
+        slot.state = State::Write;
+        if (slot.html.empty()) {
+          finish(index, true);
+          break;
+        }
+        queued = transfer(index, IORING_OP_WRITE, &slot.html[0],
+                          slot.html.size());
+        break;
+      case State::Write:
+        if (cqe.res == 0) {
+          finish(index, false);
+          break;
+        }
+        slot.done += static_cast<std::size_t>(cqe.res);
+        stats.bytesOut += static_cast<std::size_t>(cqe.res);
+        if (slot.done < slot.html.size()) {
+          queued = transfer(index, IORING_OP_WRITE, &slot.html[0],
+                            slot.html.size());
+          break;
+        }
+        finish(index, true);
+        break;
+    }
+    if (!queued) finish(index, false, "io_uring submission failed");
+  }
+
+  IoUring& ring;
+  const std::vector<BatchJob>& jobs;
+  const ConvertFunction& convert;
+  std::vector<Slot> slots;
+  std::size_t next;
+  std::size_t active;
+  std::size_t pendingCloses;
+  BatchStats stats;
+
+  unsigned threads;
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wakeWorkers;
+  std::condition_variable workersDone;  // a conversion has finished
+  std::deque<std::size_t> toConvert;  // read, waiting for a worker
+  std::size_t converting;  // taken by a worker, not yet converted
+  std::vector<std::size_t> converted;  // converted, waiting for the ring
+  bool stopping;
+  int wakeFd;
+  std::uint64_t wakeCount;  // target of the queued eventfd read
+  bool wakeArmed;
+  std::uint64_t wakeups;  // eventfd writes, guarded by `mutex`
+};
+
+}  // namespace m2h
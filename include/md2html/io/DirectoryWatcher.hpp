@@ -0,0 +1,139 @@
+#pragma once
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace m2h {
+
+// Watches a directory tree with inotify, including directories created
+// later. Like MappedFile, a watcher that could not be set up is reported
+// through operator bool.
+class DirectoryWatcher {
+ public:
+  enum class Change { Written, Removed };
+
+  explicit DirectoryWatcher(const std::string& root)
+      : fd{::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)}, dirs{} {
+    if (fd < 0) return;
+    std::vector<std::pair<std::string, Change>> ignored;
+    if (!addTree(root, ignored)) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+
+  DirectoryWatcher(const DirectoryWatcher&) = delete;
+  DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+  ~DirectoryWatcher() {
+    if (fd >= 0) ::close(fd);
+  }
+
+  explicit operator bool() const { return fd >= 0; }
+
+  // Blocks until something changes, then keeps collecting events until
+  // none arrived for `quiet`, so that a burst of writes (editor save,
+  // git checkout) is returned as one batch. Every path appears once, with
+  // its last change, in the order it was first seen.
+  std::vector<std::pair<std::string, Change>> wait(
+      std::chrono::milliseconds quiet) {
+    std::vector<std::pair<std::string, Change>> changes;
+    int timeout = -1;
+    while (true) {
+      pollfd pfd{fd, POLLIN, 0};
+      const int ready = ::poll(&pfd, 1, timeout);
+      if (ready < 0 && errno != EINTR) break;
+      if (ready == 0 && !changes.empty()) break;
+      if (ready <= 0) continue;
+      if (read(changes)) timeout = static_cast<int>(quiet.count());
+    }
+
+    std::vector<std::pair<std::string, Change>> unique;
+    std::unordered_map<std::string, std::size_t> seen;
+    for (auto&& change : changes) {
+      auto found = seen.find(change.first);
+      if (found == seen.end()) {
+        seen.emplace(change.first, unique.size());
+        unique.push_back(change);
+      } else {
+        unique[found->second].second = change.second;
+      }
+    }
+    return unique;
+  }
+
+ private:
+  static constexpr std::uint32_t mask =
+      IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE;
+
+  // Watches `dir` and everything below it. Files that already exist in it
+  // are reported as written, since they may have been created before the
+  // watch was in place.
+  bool addTree(const std::string& dir,
+               std::vector<std::pair<std::string, Change>>& changes) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (!addWatch(dir)) return false;
+    for (auto it = fs::recursive_directory_iterator(dir, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+      if (it->is_directory(ec)) {
+        addWatch(it->path().string());
+      } else if (it->is_regular_file(ec)) {
+        changes.emplace_back(it->path().string(), Change::Written);
+      }
+    }
+    return true;
+  }
+
+  bool addWatch(const std::string& dir) {
+    const int wd = ::inotify_add_watch(fd, dir.c_str(), mask | IN_ONLYDIR);
+    if (wd < 0) return false;
+    dirs[wd] = dir;
+    return true;
+  }
+
+  // Drains the pending inotify events, returns whether there were any.
+  bool read(std::vector<std::pair<std::string, Change>>& changes) {
+    alignas(inotify_event) char buf[16384];
+    bool any = false;
+    while (true) {
+      const ssize_t n = ::read(fd, buf, sizeof(buf));
+      if (n <= 0) return any;
+      for (char* p = buf; p < buf + n;) {
+        auto event = reinterpret_cast<inotify_event*>(p);
+        p += sizeof(inotify_event) + event->len;
+        any = true;
+        if (event->mask & IN_IGNORED) {
+          dirs.erase(event->wd);
+          continue;
+        }
+        auto dir = dirs.find(event->wd);
+        if (dir == dirs.end() || event->len == 0) continue;
+        const std::string path =
+            (std::filesystem::path(dir->second) / event->name).string();
+        if (event->mask & IN_ISDIR) {
+          if (event->mask & (IN_CREATE | IN_MOVED_TO)) addTree(path, changes);
+        } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+          changes.emplace_back(path, Change::Written);
+        } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+          changes.emplace_back(path, Change::Removed);
+        }
+      }
+    }
+  }
+
+  int fd;
+  std::unordered_map<int, std::string> dirs;
+};
+
+}  // namespace m2h
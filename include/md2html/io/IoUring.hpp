@@ -0,0 +1,147 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace m2h {
+
+// Minimal io_uring wrapper on top of the raw system calls, so no liburing
+// is needed. Like MappedFile, a ring that could not be set up (old kernel,
+// seccomp, ...) is reported through operator bool.
+class IoUring {
+ public:
+  explicit IoUring(unsigned entries)
+      : fd{-1}, sqRing{nullptr}, cqRing{nullptr}, sqes{nullptr},
+        sqRingSize{0}, cqRingSize{0}, sqesSize{0}, sqTailLocal{0},
+        toSubmit{0}, calls{0} {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    ++calls;
+    if (fd < 0) return;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+      if (cqRingSize > sqRingSize) sqRingSize = cqRingSize;
+      cqRingSize = sqRingSize;
+    }
+
+    sqRing = map(sqRingSize, IORING_OFF_SQ_RING);
+    cqRing = singleMmap ? sqRing : map(cqRingSize, IORING_OFF_CQ_RING);
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(
+        static_cast<void*>(map(sqesSize, IORING_OFF_SQES)));
+    if (!sqRing || !cqRing || !sqes) {
+      release();
+      return;
+    }
+
+    sqHead = field(sqRing, params.sq_off.head);
+    sqTail = field(sqRing, params.sq_off.tail);
+    sqMask = *field(sqRing, params.sq_off.ring_mask);
+    sqEntries = *field(sqRing, params.sq_off.ring_entries);
+    sqArray = field(sqRing, params.sq_off.array);
+    cqHead = field(cqRing, params.cq_off.head);
+    cqTail = field(cqRing, params.cq_off.tail);
+    cqMask = *field(cqRing, params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cqRing + params.cq_off.cqes);
+    sqTailLocal = *sqTail;
+  }
+
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+
+  ~IoUring() { release(); }
+
+  explicit operator bool() const { return fd >= 0; }
+
+  // Returns a zeroed submission entry, or nullptr while the queue is full.
+  io_uring_sqe* getSqe() {
+    const unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (sqTailLocal - head >= sqEntries) return nullptr;
+    const unsigned slot = sqTailLocal & sqMask;
+    io_uring_sqe* sqe = &sqes[slot];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray[slot] = slot;
+    ++sqTailLocal;
+    ++toSubmit;
+    return sqe;
+  }
+
+  // Submits everything queued by getSqe() and waits for `waitFor`
+  // completions, all in one system call.
+  int submitAndWait(unsigned waitFor) {
+    __atomic_store_n(sqTail, sqTailLocal, __ATOMIC_RELEASE);
+    const unsigned flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+    const int ret = static_cast<int>(::syscall(
+        __NR_io_uring_enter, fd, toSubmit, waitFor, flags, nullptr, 0));
+    ++calls;
+    if (ret >= 0) toSubmit -= static_cast<unsigned>(ret);
+    return ret;
+  }
+
+  bool peek(io_uring_cqe& cqe) {
+    const unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+    cqe = cqes[head & cqMask];
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  // io_uring_setup, io_uring_enter and mmap calls made so far
+  std::uint64_t syscalls() const { return calls; }
+
+ private:
+  char* map(std::size_t size, off_t offset) {
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, offset);
+    ++calls;
+    return p == MAP_FAILED ? nullptr : static_cast<char*>(p);
+  }
+
+  static unsigned* field(char* ring, std::uint32_t offset) {
+    return reinterpret_cast<unsigned*>(ring + offset);
+  }
+
+  void release() {
+    if (sqes) ::munmap(sqes, sqesSize);
+    if (cqRing && cqRing != sqRing) ::munmap(cqRing, cqRingSize);
+    if (sqRing) ::munmap(sqRing, sqRingSize);
+    if (fd >= 0) ::close(fd);
+    sqes = nullptr;
+    sqRing = cqRing = nullptr;
+    fd = -1;
+  }
+
+  int fd;
+  char* sqRing;
+  char* cqRing;
+  io_uring_sqe* sqes;
+  std::size_t sqRingSize;
+  std::size_t cqRingSize;
+  std::size_t sqesSize;
+
+  unsigned* sqHead;
+  unsigned* sqTail;
+  unsigned* sqArray;
+  unsigned sqMask;
+  unsigned sqEntries;
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned cqMask;
+  io_uring_cqe* cqes;
+
+  unsigned sqTailLocal;
+  unsigned toSubmit;
+  std::uint64_t calls;
+};
+
+}  // namespace m2h
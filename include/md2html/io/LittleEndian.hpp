@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+namespace m2h {
+
+// Fixed-width little-endian integers of the binary formats (the index of
+// --index and the block state of --patch), independent of the host.
+inline void writeU32(std::ostream& ost, std::uint32_t v) {
+  char b[4];
+  for (int i = 0; i < 4; ++i) b[i] = static_cast<char>(v >> (8 * i));
+  ost.write(b, 4);
+}
+
+inline void writeU64(std::ostream& ost, std::uint64_t v) {
+  char b[8];
+  for (int i = 0; i < 8; ++i) b[i] = static_cast<char>(v >> (8 * i));
+  ost.write(b, 8);
+}
+
+// False, with `v` untouched, when the stream ends first.
+inline bool readU32(std::istream& ist, std::uint32_t& v) {
+  unsigned char b[4];
+  if (!ist.read(reinterpret_cast<char*>(b), 4)) return false;
+  v = 0;
+  for (int i = 0; i < 4; ++i) v |= static_cast<std::uint32_t>(b[i]) << (8 * i);
+  return true;
+}
+
+inline bool readU64(std::istream& ist, std::uint64_t& v) {
+  unsigned char b[8];
+  if (!ist.read(reinterpret_cast<char*>(b), 8)) return false;
+  v = 0;
+  for (int i = 0; i < 8; ++i) v |= static_cast<std::uint64_t>(b[i]) << (8 * i);
+  return true;
+}
+
+}  // namespace m2h
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <string>
+
+namespace m2h {
+
+// Read-only memory mapping of a whole file. Like std::ifstream, a file
+// that could not be opened is reported through operator bool.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path)
+      : ptr{nullptr}, length{0}, ok{false} {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st;
+    if (::fstat(fd, &st) == 0) {
+      length = static_cast<std::size_t>(st.st_size);
+      if (length == 0) {
+        ok = true;
+      } else {
+        void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+          ptr = static_cast<const char*>(p);
+          ok = true;
+        }
+      }
+    }
+    ::close(fd);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (ptr) ::munmap(const_cast<char*>(ptr), length);
+  }
+
+  explicit operator bool() const { return ok; }
+  const char* data() const { return ptr; }
+  std::size_t size() const { return length; }
+
+ private:
+  const char* ptr;
+  std::size_t length;
+  bool ok;
+};
+
+}  // namespace m2h
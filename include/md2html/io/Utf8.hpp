@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace m2h {
+
+// What to do with input that is not valid UTF-8 or contains NUL bytes,
+// which the tokenizer would take for the end of the document.
+enum class Utf8Mode {
+  Reject,  // throw InvalidInput at the first bad byte
+  Repair,  // write U+FFFD for every NUL and every maximal invalid
+           // subsequence (the Unicode recommended practice)
+};
+
+// Thrown in Utf8Mode::Reject. `offset` is the byte offset of the bad
+// sequence in the input.
+class InvalidInput : public std::runtime_error {
+ public:
+  InvalidInput(const char* what, std::uint64_t offset)
+      : std::runtime_error(std::string(what) + " at byte " +
+                           std::to_string(offset)),
+        offset_{offset} {}
+
+  std::uint64_t offset() const { return offset_; }
+
+ private:
+  std::uint64_t offset_;
+};
+
+namespace utf8 {
+
+enum class Sequence { Valid, Invalid, Incomplete };
+
+// Classifies the sequence starting at `p`, `size` > 0 bytes available.
+// `length` is the sequence length if Valid, the length of its maximal
+// invalid subpart if Invalid. NUL counts as invalid.
+inline Sequence classify(const unsigned char* p, std::size_t size,
+                         std::size_t& length) {
+  const unsigned char lead = p[0];
+  length = 1;
+  if (lead < 0x80) return lead == 0 ? Sequence::Invalid : Sequence::Valid;
+  std::size_t need;
+  unsigned char low = 0x80, high = 0xbf;  // range of the second byte
+  if (lead >= 0xc2 && lead <= 0xdf) {
+    need = 2;
+  } else if (lead >= 0xe0 && lead <= 0xef) {
+    need = 3;
+    if (lead == 0xe0) low = 0xa0;   // overlong
+    if (lead == 0xed) high = 0x9f;  // surrogates
+  } else if (lead >= 0xf0 && lead <= 0xf4) {
+    need = 4;
+    if (lead == 0xf0) low = 0x90;   // overlong
+    if (lead == 0xf4) high = 0x8f;  // beyond U+10FFFF
+  } else {
+    return Sequence::Invalid;
+  }
+  for (std::size_t i = 1; i < need; ++i) {
+    if (i == size) return Sequence::Incomplete;
+    const unsigned char lo = i == 1 ? low : 0x80;
+    const unsigned char hi = i == 1 ? high : 0xbf;
+    if (p[i] < lo || p[i] > hi) {
+      length = i;
+      return Sequence::Invalid;
+    }
+  }
+  length = need;
+  return Sequence::Valid;
+}
+
+// Length of the leading run of [p, p + size) that is ASCII without NUL,
+// 16 bytes at a time where SSE2 is available.
+inline std::size_t asciiPrefix(const char* p, std::size_t size) {
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= size; i += 16) {
+    const __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    // high bit set, or equal to zero
+    const unsigned mask = static_cast<unsigned>(
+        _mm_movemask_epi8(chunk) |
+        _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero)));
+    if (mask != 0) return i + __builtin_ctz(mask);
+  }
+#endif
+  for (; i < size; ++i) {
+    const unsigned char c = static_cast<unsigned char>(p[i]);
+    if (c == 0 || c >= 0x80) break;
+  }
+  return i;
+}
+
+}  // namespace utf8
+
+// Offset of the first NUL or invalid UTF-8 sequence in [data, data + size),
+// or `size` if there is none. A sequence cut off at the end is invalid.
+inline std::size_t findInvalidUtf8(const char* data, std::size_t size) {
+  const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+  std::size_t i = 0;
+  while (true) {
+    i += utf8::asciiPrefix(data + i, size - i);
+    if (i == size) return size;
+    // multi-byte text tends to come in runs, check one run before
+    // trying the vector loop again
+    do {
+      std::size_t length;
+      if (utf8::classify(bytes + i, size - i, length) !=
+          utf8::Sequence::Valid) {
+        return i;
+      }
+      i += length;
+    } while (i < size && bytes[i] >= 0x80);
+  }
+}
+
+// Appends input given in chunks to `out`, checked on the way, so reading a
+// file or copying from a mapping touches every byte once. Sequences may be
+// split across chunks. Afterwards `out` holds valid UTF-8 without NUL,
+// which Tokenizer can take together with its explicit length.
+class Utf8Sink {
+ public:
+  static constexpr const char* replacement = "\xef\xbf\xbd";  // U+FFFD
+
+  // `offset` is where the first chunk starts in the input, for errors.
+  Utf8Sink(std::string& out, Utf8Mode mode, std::uint64_t offset = 0)
+      : out{out}, mode{mode}, pending{}, pendingSize{0}, offset{offset},
+        replaced_{0} {}
+
+  void append(const char* data, std::size_t size) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    std::size_t i = 0;
+    if (pendingSize != 0) {
+      i = completePending(bytes, size);
+      if (pendingSize != 0) {  // still incomplete
+        offset += size;
+        return;
+      }
+    }
+    std::size_t clean = i;  // start of the bytes not yet appended
+    while (true) {
+      i += utf8::asciiPrefix(data + i, size - i);
+      if (i == size) break;
+      do {
+        std::size_t length;
+        const utf8::Sequence sequence =
+            utf8::classify(bytes + i, size - i, length);
+        if (sequence == utf8::Sequence::Valid) {
+          i += length;
+          continue;
+        }
+        out.append(data + clean, i - clean);
+        if (sequence == utf8::Sequence::Incomplete) {
+          // the rest of the sequence comes with the next chunk
+          std::memcpy(pending, data + i, size - i);
+          pendingSize = size - i;
+          offset += size;
+          return;
+        }
+        invalid(bytes[i] == 0, offset + i);
+        i += length;
+        clean = i;
+      } while (i < size && bytes[i] >= 0x80);
+    }
+    out.append(data + clean, size - clean);
+    offset += size;
+  }
+
+  // Ends the input; a sequence still incomplete is invalid.
+  void finish() {
+    if (pendingSize == 0) return;
+    const std::size_t before = pendingSize;
+    pendingSize = 0;
+    invalid(false, offset - before);
+  }
+
+  // U+FFFD written in Utf8Mode::Repair.
+  std::uint64_t replaced() const { return replaced_; }
+
+ private:
+  // Completes the sequence begun by the last chunk with the first bytes
+  // of this one; returns how many of them it took.
+  std::size_t completePending(const unsigned char* bytes, std::size_t size) {
+    unsigned char joined[4];
+    std::memcpy(joined, pending, pendingSize);
+    const std::size_t added = std::min<std::size_t>(size, 4 - pendingSize);
+    std::memcpy(joined + pendingSize, bytes, added);
+    std::size_t length;
+    const utf8::Sequence sequence =
+        utf8::classify(joined, pendingSize + added, length);
+    if (sequence == utf8::Sequence::Incomplete) {
+      std::memcpy(pending + pendingSize, bytes, size);
+      pendingSize += size;
+      return size;
+    }
+    const std::size_t before = pendingSize;
+    pendingSize = 0;
+    if (sequence == utf8::Sequence::Valid) {
+      out.append(reinterpret_cast<const char*>(joined), length);
+    } else {
+      // the pending bytes are a valid prefix, so the invalid subpart
+      // covers them and maybe some bytes of this chunk
+      invalid(false, offset - before);
+    }
+    return length - before;
+  }
+
+  void invalid(bool nul, std::uint64_t at) {
+    if (mode == Utf8Mode::Reject) {
+      throw InvalidInput(nul ? "NUL byte" : "invalid UTF-8", at);
+    }
+    out.append(replacement, 3);
+    ++replaced_;
+  }
+
+  std::string& out;
+  Utf8Mode mode;
+  char pending[4];  // an incomplete sequence at the end of the last chunk
+  std::size_t pendingSize;
+  std::uint64_t offset;  // input bytes before the current chunk
+  std::uint64_t replaced_;
+};
+
+// Checks `text` in place; it is only copied when there is something to
+// repair. Returns the number of replacements.
+inline std::uint64_t sanitizeUtf8(std::string& text, Utf8Mode mode) {
+  const std::size_t bad = findInvalidUtf8(text.data(), text.size());
+  if (bad == text.size()) return 0;
+  std::string repaired;
+  repaired.reserve(text.size() + 16);
+  Utf8Sink sink(repaired, mode);
+  sink.append(text.data(), text.size());
+  sink.finish();
+  text.swap(repaired);
+  return sink.replaced();
+}
+
+}  // namespace m2h
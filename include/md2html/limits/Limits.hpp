@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace m2h {
+
+// Resource limits of a single conversion. Everything defaults to
+// unlimited, so a default constructed Limits never fails a check.
+struct Limits {
+  using Clock = std::chrono::steady_clock;
+
+  std::uint64_t inputBytes = std::numeric_limits<std::uint64_t>::max();
+  std::size_t tokens = std::numeric_limits<std::size_t>::max();
+  std::size_t nodes = std::numeric_limits<std::size_t>::max();
+  std::size_t depth = std::numeric_limits<std::size_t>::max();
+  std::uint64_t outputBytes = std::numeric_limits<std::uint64_t>::max();
+  Clock::time_point deadline = Clock::time_point::max();
+  // set from any thread (or a signal handler) to stop the conversion
+  const std::atomic<bool>* cancel = nullptr;
+  // set by runPipeline when another stage of the same conversion failed
+  const std::atomic<bool>* stop = nullptr;
+};
+
+enum class LimitKind {
+  InputBytes,
+  Tokens,
+  Nodes,
+  Depth,
+  OutputBytes,
+  Deadline,
+  Cancelled,
+};
+
+inline const char* limitName(LimitKind kind) {
+  switch (kind) {
+    case LimitKind::InputBytes:
+      return "input size";
+    case LimitKind::Tokens:
+      return "token count";
+    case LimitKind::Nodes:
+      return "node count";
+    case LimitKind::Depth:
+      return "nesting depth";
+    case LimitKind::OutputBytes:
+      return "output size";
+    case LimitKind::Deadline:
+      return "deadline";
+    case LimitKind::Cancelled:
+      return "cancellation";
+  }
+  return "limit";
+}
+
+// Thrown by the tokenizer, the parser and the renderers when a conversion
+// breaks one of its Limits. `offset` is the byte offset in the input the
+// conversion had reached.
+class LimitExceeded : public std::runtime_error {
+ public:
+  LimitExceeded(LimitKind kind, std::uint64_t limit, std::uint64_t offset)
+      : std::runtime_error(message(kind, limit, offset)), kind_{kind},
+        limit_{limit}, offset_{offset} {}
+
+  LimitKind kind() const { return kind_; }
+  std::uint64_t limit() const { return limit_; }
+  std::uint64_t offset() const { return offset_; }
+
+ private:
+  static std::string message(LimitKind kind, std::uint64_t limit,
+                             std::uint64_t offset) {
+    std::string m = kind == LimitKind::Cancelled ? "conversion cancelled"
+                                                 : limitName(kind) +
+                                                       std::string(" exceeded");
+    if (kind != LimitKind::Deadline && kind != LimitKind::Cancelled) {
+      m += " (limit " + std::to_string(limit) + ")";
+    }
+    return m + " at byte " + std::to_string(offset);
+  }
+
+  LimitKind kind_;
+  std::uint64_t limit_;
+  std::uint64_t offset_;
+};
+
+// Checks one stage of a conversion against its Limits. The counters are
+// plain comparisons meant to be called on every step; the clock and the
+// cancellation flag are only looked at on every pollInterval-th poll(), or
+// sooner once the offset moved pollBytes on, since a single step can cover
+// much of the input. Stages call checkNow() when they are done, so a
+// deadline that passed during their last steps is not missed. Each thread
+// of a conversion uses its own checker.
+class LimitChecker {
+ public:
+  static constexpr unsigned pollInterval = 1024;
+  static constexpr std::uint64_t pollBytes = 64 * 1024;
+
+  explicit LimitChecker(const Limits& limits = Limits{})
+      : limits{limits}, countdown{pollInterval}, nextCheck{pollBytes} {}
+
+  const Limits& get() const { return limits; }
+
+  void checkInput(std::uint64_t bytes) const {
+    if (bytes > limits.inputBytes) {
+      throw LimitExceeded(LimitKind::InputBytes, limits.inputBytes,
+                          limits.inputBytes);
+    }
+  }
+
+  void checkTokens(std::size_t tokens, std::uint64_t offset) const {
+    if (tokens > limits.tokens) {
+      throw LimitExceeded(LimitKind::Tokens, limits.tokens, offset);
+    }
+  }
+
+  void checkNodes(std::size_t nodes, std::uint64_t offset) const {
+    if (nodes > limits.nodes) {
+      throw LimitExceeded(LimitKind::Nodes, limits.nodes, offset);
+    }
+  }
+
+  void checkDepth(std::size_t depth, std::uint64_t offset) const {
+    if (depth > limits.depth) {
+      throw LimitExceeded(LimitKind::Depth, limits.depth, offset);
+    }
+  }
+
+  void checkOutput(std::uint64_t bytes, std::uint64_t offset) const {
+    if (bytes > limits.outputBytes) {
+      throw LimitExceeded(LimitKind::OutputBytes, limits.outputBytes, offset);
+    }
+  }
+
+  // Deadline, cancellation and input bytes consumed so far.
+  void poll(std::uint64_t offset) {
+    if (--countdown > 0 && offset < nextCheck) return;
+    countdown = pollInterval;
+    nextCheck = offset + pollBytes;
+    checkNow(offset);
+  }
+
+  void checkNow(std::uint64_t offset) const {
+    checkInput(offset);
+    if ((limits.cancel && limits.cancel->load(std::memory_order_relaxed)) ||
+        (limits.stop && limits.stop->load(std::memory_order_relaxed))) {
+      throw LimitExceeded(LimitKind::Cancelled, 0, offset);
+    }
+    if (limits.deadline != Limits::Clock::time_point::max() &&
+        Limits::Clock::now() > limits.deadline) {
+      throw LimitExceeded(LimitKind::Deadline, 0, offset);
+    }
+  }
+
+ private:
+  Limits limits;
+  unsigned countdown;
+  std::uint64_t nextCheck;  // offset at which poll() looks at the clock
+};
+
+}  // namespace m2h
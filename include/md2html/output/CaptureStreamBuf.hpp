@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <streambuf>
+#include <string>
+#include <utility>
+
+namespace m2h {
+
+// Forwards to `target` and keeps a copy of everything written since the
+// last take(), e.g. to cut the html of single blocks out of the output.
+// Unbuffered, so take() never needs a flush that would reach `target`.
+// Without a target it only collects the output, which take() then moves
+// out without a copy.
+class CaptureStreamBuf : public std::streambuf {
+ public:
+  explicit CaptureStreamBuf(std::streambuf* target = nullptr)
+      : target{target}, captured{} {}
+
+  // bytes written since the last take()
+  std::size_t size() const { return captured.size(); }
+
+  std::string take() {
+    std::string bytes = std::move(captured);
+    captured.clear();
+    return bytes;
+  }
+
+ protected:
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    captured.append(s, n);
+    return target ? target->sputn(s, n) : n;
+  }
+
+  int_type overflow(int_type c) override {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::not_eof(c);
+    }
+    captured += traits_type::to_char_type(c);
+    return target ? target->sputc(traits_type::to_char_type(c)) : c;
+  }
+
+  int sync() override { return target ? target->pubsync() : 0; }
+
+ private:
+  std::streambuf* target;
+  std::string captured;
+};
+
+}  // namespace m2h
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <zlib.h>
+
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+
+namespace m2h {
+
+// Compresses everything written to it into gzip format and writes the
+// compressed bytes to `sink` as soon as zlib produces them. Only a fixed
+// input and output window is kept in memory, never the whole document.
+//
+// sync() (e.g. std::endl) hands pending bytes to deflate without forcing a
+// zlib flush, so per-line flushing does not hurt the compression ratio.
+// The gzip trailer is written by finish() or the destructor.
+class GzipStreamBuf : public std::streambuf {
+ public:
+  explicit GzipStreamBuf(std::ostream& sink, int level = Z_DEFAULT_COMPRESSION)
+      : sink{sink}, stream{}, finished{false} {
+    // windowBits 15 + 16 selects the gzip wrapper instead of raw zlib
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      throw std::runtime_error("deflateInit2 failed");
+    }
+    setp(in, in + sizeof(in));
+  }
+
+  GzipStreamBuf(const GzipStreamBuf&) = delete;
+  GzipStreamBuf& operator=(const GzipStreamBuf&) = delete;
+
+  ~GzipStreamBuf() {
+    finish();
+    deflateEnd(&stream);
+  }
+
+  bool finish() {
+    if (finished) return true;
+    finished = true;
+    return compress(Z_FINISH);
+  }
+
+  uLong totalIn() const { return stream.total_in; }
+  uLong totalOut() const { return stream.total_out; }
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (finished || !compress(Z_NO_FLUSH)) return traits_type::eof();
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::not_eof(c);
+    }
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+  }
+
+  int sync() override {
+    if (finished) return 0;
+    return compress(Z_NO_FLUSH) ? 0 : -1;
+  }
+
+ private:
+  bool compress(int flush) {
+    stream.next_in = reinterpret_cast<Bytef*>(pbase());
+    stream.avail_in = static_cast<uInt>(pptr() - pbase());
+    int ret = Z_OK;
+    do {
+      stream.next_out = reinterpret_cast<Bytef*>(out);
+      stream.avail_out = sizeof(out);
+      ret = deflate(&stream, flush);
+      if (ret == Z_STREAM_ERROR) return false;
+      sink.write(out, sizeof(out) - stream.avail_out);
+    } while (stream.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+    setp(in, in + sizeof(in));
+    return static_cast<bool>(sink);
+  }
+
+  std::ostream& sink;
+  z_stream stream;
+  bool finished;
+  char in[16384];
+  char out[16384];
+};
+
+}  // namespace m2h
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+#include "../hash/Sha256.hpp"
+#include "../hash/Xxh64.hpp"
+
+namespace m2h {
+
+// What HashingStreamBuf saw pass through it.
+struct OutputDigest {
+  std::uint64_t bytes = 0;
+  std::uint64_t xxh64 = 0;
+  std::string sha256;  // hex, empty unless requested
+
+  // Strong ETag value (with quotes), from SHA-256 when available.
+  std::string etag() const {
+    if (!sha256.empty()) return "\"" + sha256 + "\"";
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx",
+                  static_cast<unsigned long long>(xxh64));
+    return "\"" + std::string(hex) + "\"";
+  }
+};
+
+// Forwards everything written to it into `target` and hashes it on the
+// way, in the same 4 KiB chunks, so the digest of the output is known as
+// soon as it has been written without reading it back.
+class HashingStreamBuf : public std::streambuf {
+ public:
+  explicit HashingStreamBuf(std::streambuf* target, bool sha256 = false)
+      : target{target}, bytes{0}, xxh64{}, sha{sha256 ? new Sha256 : nullptr} {
+    setp(buffer, buffer + sizeof(buffer));
+  }
+
+  ~HashingStreamBuf() { drain(); }
+
+  // Digest of everything written so far; pending bytes are forwarded first.
+  OutputDigest digest() {
+    drain();
+    OutputDigest d;
+    d.bytes = bytes;
+    d.xxh64 = xxh64.digest();
+    if (sha) d.sha256 = sha->hexDigest();
+    return d;
+  }
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (!drain()) return traits_type::eof();
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::not_eof(c);
+    }
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+  }
+
+  int sync() override {
+    if (!drain()) return -1;
+    return target->pubsync();
+  }
+
+ private:
+  bool drain() {
+    const std::streamsize n = pptr() - pbase();
+    if (n == 0) return true;
+    const std::streamsize written = target->sputn(pbase(), n);
+    if (written > 0) {
+      xxh64.update(pbase(), static_cast<std::size_t>(written));
+      if (sha) sha->update(pbase(), static_cast<std::size_t>(written));
+      bytes += static_cast<std::uint64_t>(written);
+    }
+    setp(buffer, buffer + sizeof(buffer));
+    return written == n;
+  }
+
+  std::streambuf* target;
+  std::uint64_t bytes;
+  Xxh64 xxh64;
+  std::unique_ptr<Sha256> sha;
+  char buffer[4096];
+};
+
+}  // namespace m2h
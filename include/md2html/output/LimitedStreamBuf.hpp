@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <streambuf>
+
+namespace m2h {
+
+// Forwards to `target` until `limit` bytes have been written. Writes past
+// the limit are dropped and fail, which puts the writing stream into the
+// bad state; requested() keeps counting them, to be checked against
+// Limits::outputBytes.
+class LimitedStreamBuf : public std::streambuf {
+ public:
+  LimitedStreamBuf(std::streambuf* target, std::uint64_t limit)
+      : target{target}, limit{limit}, count{0} {}
+
+  std::uint64_t requested() const { return count; }
+
+ protected:
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    count += static_cast<std::uint64_t>(n);
+    if (count > limit) return 0;
+    return target->sputn(s, n);
+  }
+
+  int_type overflow(int_type c) override {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::not_eof(c);
+    }
+    if (++count > limit) return traits_type::eof();
+    return target->sputc(traits_type::to_char_type(c));
+  }
+
+  int sync() override { return target->pubsync(); }
+
+ private:
+  std::streambuf* target;
+  std::uint64_t limit;
+  std::uint64_t count;
+};
+
+}  // namespace m2h
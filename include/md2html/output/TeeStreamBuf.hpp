@@ -0,0 +1,50 @@
+#pragma once
+
+#include <streambuf>
+
+namespace m2h {
+
+// Forwards every byte written to it into two destination buffers, so one
+// pass of Node::print can feed several sinks (plain file, compressor, ...).
+class TeeStreamBuf : public std::streambuf {
+ public:
+  TeeStreamBuf(std::streambuf* first, std::streambuf* second)
+      : first{first}, second{second} {
+    setp(buffer, buffer + sizeof(buffer));
+  }
+
+  ~TeeStreamBuf() { drain(); }
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (!drain()) return traits_type::eof();
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::not_eof(c);
+    }
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+  }
+
+  int sync() override {
+    if (!drain()) return -1;
+    const int r1 = first->pubsync();
+    const int r2 = second->pubsync();
+    return r1 == 0 && r2 == 0 ? 0 : -1;
+  }
+
+ private:
+  bool drain() {
+    const std::streamsize n = pptr() - pbase();
+    if (n == 0) return true;
+    const bool ok = first->sputn(pbase(), n) == n && second->sputn(pbase(), n) == n;
+    setp(buffer, buffer + sizeof(buffer));
+    return ok;
+  }
+
+  std::streambuf* first;
+  std::streambuf* second;
+  char buffer[4096];
+};
+
+}  // namespace m2h
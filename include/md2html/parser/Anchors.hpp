@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "../ParsingUtility.hpp"
+
+namespace m2h {
+
+// GitHub style anchors: lower-case, spaces become '-', other ASCII
+// punctuation is dropped, repeated anchors get a "-1", "-2"... suffix.
+class Anchors {
+ public:
+  Anchors() : anchors{} {}
+
+  std::string unique(const std::string& text) {
+    auto slug = std::string{};
+    for (char c : trim(text)) {
+      if (isLetter(c) || c == '-') {
+        slug += toLower(c);
+      } else if (isSpace(c)) {
+        slug += '-';
+      } else if (static_cast<unsigned char>(c) >= 0x80) {
+        slug += c;
+      }
+    }
+    auto found = anchors.find(slug);
+    if (found == anchors.end()) {
+      anchors.emplace(slug, 1);
+      return slug;
+    }
+    auto unique = slug + "-" + std::to_string(found->second++);
+    anchors.emplace(unique, 1);
+    return unique;
+  }
+
+  void clear() { anchors.clear(); }
+
+ private:
+  std::unordered_map<std::string, int> anchors;
+};
+
+}  // namespace m2h
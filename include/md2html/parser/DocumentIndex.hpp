@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../ParsingUtility.hpp"
+#include "../io/LittleEndian.hpp"
+#include "Anchors.hpp"
+
+namespace m2h {
+
+struct HeadingEntry {
+  int level;
+  std::string text;
+  std::string anchor;
+  std::size_t offset;  // byte offset of the heading prefix in the source
+};
+
+struct LinkEntry {
+  std::string url;
+  std::string text;
+  std::size_t offset;  // byte offset of '[' in the source
+};
+
+struct ImageEntry {
+  std::string url;
+  std::string alt;
+  std::size_t offset;  // byte offset of '!' in the source
+};
+
+// Side index filled by Parser while it parses, so tools that only need
+// headings and outgoing references do not have to parse a second time.
+class DocumentIndex {
+ public:
+  static constexpr std::uint32_t binaryVersion = 1;
+
+  DocumentIndex() : headings{}, links{}, images{}, anchors{} {}
+
+  void addHeading(int level, const std::string& text, std::size_t offset) {
+    headings.push_back({level, text, anchors.unique(text), offset});
+  }
+
+  void addLink(const std::string& url, const std::string& text,
+               std::size_t offset) {
+    links.push_back({url, text, offset});
+  }
+
+  void addImage(const std::string& url, const std::string& alt,
+                std::size_t offset) {
+    images.push_back({url, alt, offset});
+  }
+
+  // Moves every offset by `base`, for an index of a part of a document
+  // that starts there.
+  void rebase(std::size_t base) {
+    for (auto&& h : headings) h.offset += base;
+    for (auto&& l : links) l.offset += base;
+    for (auto&& m : images) m.offset += base;
+  }
+
+  void clear() {
+    headings.clear();
+    links.clear();
+    images.clear();
+    anchors.clear();
+  }
+
+  void writeJson(std::ostream& ost) const {
+    ost << "{\"headings\":[";
+    for (std::size_t i = 0; i < headings.size(); ++i) {
+      auto&& h = headings[i];
+      if (i != 0) ost << ',';
+      ost << "{\"level\":" << h.level << ",\"text\":\"" << escapeJson(h.text)
+          << "\",\"anchor\":\"" << escapeJson(h.anchor)
+          << "\",\"offset\":" << h.offset << '}';
+    }
+    ost << "],\"links\":[";
+    for (std::size_t i = 0; i < links.size(); ++i) {
+      auto&& l = links[i];
+      if (i != 0) ost << ',';
+      ost << "{\"url\":\"" << escapeJson(l.url) << "\",\"text\":\""
+          << escapeJson(l.text) << "\",\"offset\":" << l.offset << '}';
+    }
+    ost << "],\"images\":[";
+    for (std::size_t i = 0; i < images.size(); ++i) {
+      auto&& m = images[i];
+      if (i != 0) ost << ',';
+      ost << "{\"url\":\"" << escapeJson(m.url) << "\",\"alt\":\""
+          << escapeJson(m.alt) << "\",\"offset\":" << m.offset << '}';
+    }
+    ost << "]}" << std::endl;
+  }
+
+  // Layout (all integers little-endian):
+  //   "M2HI" u32 version u32 #headings u32 #links u32 #images
+  //   heading: u8 level, u64 offset, str text, str anchor
+  //   link:    u64 offset, str url, str text
+  //   image:   u64 offset, str url, str alt
+  // where str is u32 length followed by the raw bytes.
+  void writeBinary(std::ostream& ost) const {
+    ost.write("M2HI", 4);
+    writeU32(ost, binaryVersion);
+    writeU32(ost, headings.size());
+    writeU32(ost, links.size());
+    writeU32(ost, images.size());
+    for (auto&& h : headings) {
+      ost.put(static_cast<char>(h.level));
+      writeU64(ost, h.offset);
+      writeString(ost, h.text);
+      writeString(ost, h.anchor);
+    }
+    for (auto&& l : links) {
+      writeU64(ost, l.offset);
+      writeString(ost, l.url);
+      writeString(ost, l.text);
+    }
+    for (auto&& m : images) {
+      writeU64(ost, m.offset);
+      writeString(ost, m.url);
+      writeString(ost, m.alt);
+    }
+  }
+
+  std::vector<HeadingEntry> headings;
+  std::vector<LinkEntry> links;
+  std::vector<ImageEntry> images;
+
+ private:
+  static void writeString(std::ostream& ost, const std::string& s) {
+    writeU32(ost, s.size());
+    ost.write(s.data(), s.size());
+  }
+
+  Anchors anchors;
+};
+
+}  // namespace m2h
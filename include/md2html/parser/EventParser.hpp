@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "../tokenizer/Token.hpp"
+#include "Node.hpp"
+#include "Parser.hpp"
+
+namespace m2h {
+
+// Callbacks of the event (SAX style) API. Handlers derive from this and
+// redeclare the callbacks they need; dispatch is static, so callbacks a
+// handler does not declare compile to nothing.
+//
+//   blockSource           byte range of the block whose enterBlock follows
+//   enterBlock/exitBlock  every block node; `level` is the heading level
+//                         for NodeType::Heading and 0 otherwise
+//   text                  heading text and plain paragraph text
+//   code                  inline code, and the content of a CodeBlock
+//   emphasis/link/image   inline markup inside paragraphs
+//
+// All strings are raw source text; escaping is up to the handler.
+struct EventHandler {
+  void blockSource(std::size_t /*begin*/, std::size_t /*end*/) {}
+  void enterBlock(NodeType /*type*/, int /*level*/) {}
+  void exitBlock(NodeType /*type*/, int /*level*/) {}
+  void text(const std::string& /*text*/) {}
+  void code(const std::string& /*code*/) {}
+  void emphasis(int /*level*/, const std::string& /*text*/) {}
+  void link(const std::string& /*url*/, const std::string& /*text*/) {}
+  void image(const std::string& /*url*/, const std::string& /*alt*/) {}
+};
+
+// Reports a node that has no block children: inline nodes, headings and
+// code blocks.
+template <class Handler>
+void emitLeaf(const Node* node, Handler& handler) {
+  switch (node->type) {
+    case NodeType::Text:
+      handler.text(static_cast<const TextNode*>(node)->text);
+      return;
+    case NodeType::InlineCode:
+      handler.code(static_cast<const InlineCodeNode*>(node)->code);
+      return;
+    case NodeType::Emphasis: {
+      auto emphasis = static_cast<const EmphasisNode*>(node);
+      handler.emphasis(emphasis->level, emphasis->text);
+      return;
+    }
+    case NodeType::Link: {
+      auto link = static_cast<const LinkNode*>(node);
+      handler.link(link->url, link->text);
+      return;
+    }
+    case NodeType::Image: {
+      auto image = static_cast<const ImageNode*>(node);
+      handler.image(image->url, image->alt);
+      return;
+    }
+    case NodeType::Heading: {
+      auto heading = static_cast<const HeadingNode*>(node);
+      handler.blockSource(node->sourceBegin, node->sourceEnd);
+      handler.enterBlock(node->type, heading->level);
+      handler.text(heading->heading);
+      handler.exitBlock(node->type, heading->level);
+      return;
+    }
+    case NodeType::CodeBlock:
+      handler.blockSource(node->sourceBegin, node->sourceEnd);
+      handler.enterBlock(node->type, 0);
+      handler.code(static_cast<const CodeBlockNode*>(node)->text);
+      handler.exitBlock(node->type, 0);
+      return;
+    default:
+      handler.blockSource(node->sourceBegin, node->sourceEnd);
+      handler.enterBlock(node->type, 0);
+      handler.exitBlock(node->type, 0);
+      return;
+  }
+}
+
+// Reports `node` and its content to `handler`, in document order. As in
+// Node::print, list items only report their first child. Nested blocks are
+// walked with an explicit stack, so arbitrarily deep block quotes and
+// lists cannot overflow the call stack.
+template <class Handler>
+void emitEvents(const Node* node, Handler& handler) {
+  struct Frame {
+    const Node* node;
+    std::size_t next;
+    std::size_t end;
+  };
+  std::vector<Frame> stack;
+
+  while (node) {
+    switch (node->type) {
+      case NodeType::None:
+        stack.push_back({node, 0, node->children().size()});
+        break;
+      case NodeType::Paragraph:
+        // paragraph children are always inline nodes
+        handler.blockSource(node->sourceBegin, node->sourceEnd);
+        handler.enterBlock(node->type, 0);
+        for (auto&& child : node->children()) emitLeaf(child, handler);
+        handler.exitBlock(node->type, 0);
+        break;
+      case NodeType::BlockQuote:
+      case NodeType::OrderedList:
+      case NodeType::UnorderedList:
+        handler.blockSource(node->sourceBegin, node->sourceEnd);
+        handler.enterBlock(node->type, 0);
+        stack.push_back({node, 0, node->children().size()});
+        break;
+      case NodeType::OrderedListItem:
+      case NodeType::UnorderedListItem:
+        handler.blockSource(node->sourceBegin, node->sourceEnd);
+        handler.enterBlock(node->type, 0);
+        stack.push_back(
+            {node, 0, std::min<std::size_t>(node->children().size(), 1)});
+        break;
+      default:
+        emitLeaf(node, handler);
+        break;
+    }
+
+    node = nullptr;
+    while (!stack.empty() && !node) {
+      Frame& top = stack.back();
+      if (top.next < top.end) {
+        node = top.node->children()[top.next++];
+      } else {
+        if (top.node->type != NodeType::None) {
+          handler.exitBlock(top.node->type, 0);
+        }
+        stack.pop_back();
+      }
+    }
+  }
+}
+
+// Parses [first, last) and reports it to `handler` without keeping the
+// document tree: each top-level block is reported and freed as soon as
+// the parser completes it, so at most one top-level block is alive.
+template <class TokenIterator, class Sentinel, class Handler>
+void parseEvents(TokenIterator first, Sentinel last, Handler& handler) {
+  BasicParser<TokenIterator> parser;
+  RootNode root;
+  parser.parse(first, last, &root, [&](Node* block) {
+    emitEvents(block, handler);
+    destroyTree(block);
+  });
+}
+
+template <class Handler>
+void parseEvents(std::vector<Token>& tokens, Handler& handler) {
+  parseEvents(tokens.begin(), tokens.end(), handler);
+}
+
+}  // namespace m2h
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace m2h {
+
+// 1-based line and byte column.
+struct SourcePosition {
+  std::size_t line;
+  std::size_t column;
+};
+
+// Maps byte offsets in a document to line/column. Lines end where
+// Tokenizer ends them: at "\n", at "\r\n" and at a '\r' on its own. The
+// line starts are collected on the first query, in one pass that compares
+// 16 bytes at a time against '\n' and '\r' where SSE2 is available; every
+// query is then a binary search over them. The first query builds the
+// index exactly once, also when several threads query at the same time. A
+// part of a larger document, such as a section, is numbered from its
+// `firstLine` and, on that line, its `firstColumn` on.
+class LineIndex {
+ public:
+  LineIndex(const char* data, std::size_t size, std::size_t firstLine = 1,
+            std::size_t firstColumn = 1)
+      : data{data}, size{size}, firstLine{firstLine},
+        firstColumn{firstColumn}, built{}, starts{} {}
+
+  SourcePosition position(std::size_t offset) const {
+    std::call_once(built, [this] { build(); });
+    const auto after = std::upper_bound(starts.begin(), starts.end(), offset);
+    const std::size_t line = after - starts.begin();
+    const std::size_t column = line == 1 ? firstColumn : 1;
+    return {line + firstLine - 1, offset - starts[line - 1] + column};
+  }
+
+  std::size_t lines() const {
+    std::call_once(built, [this] { build(); });
+    return starts.size();
+  }
+
+  // Number of line ends in [data, data + size), without building an
+  // index. A '\r' in the last byte counts as one, so `size` should end at
+  // a line start.
+  static std::size_t newlines(const char* data, std::size_t size) {
+    std::size_t count = 0;
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+      count += __builtin_popcount(lineEnds(data, size, i));
+    }
+#endif
+    for (; i < size; ++i) count += endsLine(data, size, i);
+    return count;
+  }
+
+ private:
+  void build() const {
+    starts.push_back(0);
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+      unsigned mask = lineEnds(data, size, i);
+      while (mask != 0) {
+        starts.push_back(i + __builtin_ctz(mask) + 1);
+        mask &= mask - 1;
+      }
+    }
+#endif
+    for (; i < size; ++i) {
+      if (endsLine(data, size, i)) starts.push_back(i + 1);
+    }
+  }
+
+  // whether the line ends with data[i]: a '\n', or a '\r' without one
+  static bool endsLine(const char* data, std::size_t size, std::size_t i) {
+    return data[i] == '\n' ||
+           (data[i] == '\r' && (i + 1 == size || data[i + 1] != '\n'));
+  }
+
+#if defined(__SSE2__)
+  // endsLine() for the 16 bytes from data[i] on, one bit each
+  static unsigned lineEnds(const char* data, std::size_t size, std::size_t i) {
+    const __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    const unsigned lf = static_cast<unsigned>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))));
+    unsigned cr = static_cast<unsigned>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+    if (cr != 0) {
+      // a '\r' followed by '\n' is ended by the '\n'
+      unsigned followed = lf >> 1;
+      if (i + 16 < size && data[i + 16] == '\n') followed |= 1u << 15;
+      cr &= ~followed;
+    }
+    return lf | cr;
+  }
+#endif
+
+  const char* data;
+  std::size_t size;
+  std::size_t firstLine;
+  std::size_t firstColumn;
+  mutable std::once_flag built;
+  mutable std::vector<std::size_t> starts;
+};
+
+}  // namespace m2h
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <vector>
 
+#include "../ParsingUtility.hpp"
+
 using namespace std::string_literals;
 
 namespace m2h {
@@ -22,21 +27,87 @@ enum class NodeType {
   Heading,
   InlineCode,
   CodeBlock,
+  Text,
+  Emphasis,
+  Link,
+  Image,
+};
+
+struct Node;
+
+// The children of a const node, handed out as const nodes themselves.
+class ConstChildren {
+ public:
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = const Node*;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Node* const*;
+    using reference = const Node*;
+
+    explicit iterator(Node* const* p) : p{p} {}
+    const Node* operator*() const { return *p; }
+    iterator& operator++() {
+      ++p;
+      return *this;
+    }
+    iterator operator++(int) { return iterator(p++); }
+    bool operator==(iterator other) const { return p == other.p; }
+    bool operator!=(iterator other) const { return p != other.p; }
+
+   private:
+    Node* const* p;
+  };
+
+  explicit ConstChildren(const std::vector<Node*>& nodes) : nodes{&nodes} {}
+  iterator begin() const { return iterator(nodes->data()); }
+  iterator end() const { return iterator(nodes->data() + nodes->size()); }
+  std::size_t size() const { return nodes->size(); }
+  bool empty() const { return nodes->empty(); }
+  const Node* operator[](std::size_t i) const { return (*nodes)[i]; }
+  const Node* back() const { return nodes->back(); }
+
+ private:
+  const std::vector<Node*>* nodes;
 };
 
 struct Node {
-  explicit Node(NodeType&& type) : type{type}, children{} {}
-  virtual void print(std::ostream& ost, const std::string& prefix) = 0;
-  virtual NodeType getType() { return type; }
-  void addChild(Node* node) { children.push_back(node); }
+  explicit Node(NodeType&& type)
+      : type{type}, sourceBegin{0}, sourceEnd{0}, childNodes{} {}
+  virtual ~Node() = default;
+  virtual void print(std::ostream& ost, const std::string& prefix) const = 0;
+  virtual NodeType getType() const { return type; }
+  void addChild(Node* node) { childNodes.push_back(node); }
+  // Constness carries over to the children, so a tree shared as const
+  // (Document) cannot be changed through them.
+  std::vector<Node*>& children() { return childNodes; }
+  ConstChildren children() const { return ConstChildren(childNodes); }
   NodeType type;
-  std::vector<Node*> children;
+  // Byte range [sourceBegin, sourceEnd) of a block in the parsed input;
+  // not set for inline nodes.
+  std::size_t sourceBegin;
+  std::size_t sourceEnd;
+
+ private:
+  std::vector<Node*> childNodes;
 };
 
+// Nested blocks are indented by two spaces per level up to this depth and
+// no further, so the html of deeply nested input stays linear in its size.
+constexpr std::size_t maxIndentDepth = 64;
+
+// Prints a BlockQuote, list or list item node and everything below it with
+// an explicit stack instead of recursion, so nesting depth is bounded by
+// the heap only, and one indentation string is shared by all levels.
+inline void printContainer(const Node* node, std::ostream& ost,
+                           const std::string& prefix);
+
 struct RootNode : Node {
   RootNode() : Node(NodeType::None) {}
-  virtual void print(std::ostream& ost, const std::string& prefix) override {
-    for (auto&& child : children) {
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
+    for (const Node* child : children()) {
       child->print(ost, "");
     }
   }
@@ -46,7 +117,8 @@ struct HeadingNode : Node {
   HeadingNode(int level, const std::string& heading)
       : Node(NodeType::Heading), level{level}, heading{heading} {}
 
-  virtual void print(std::ostream& ost, const std::string& prefix) override {
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
     const std::string lvl = std::to_string(level);
     std::string t1 = "<h"s + lvl + ">"s;
     std::string t2 = "</h"s + lvl + ">"s;
@@ -59,80 +131,134 @@ struct HeadingNode : Node {
 
 struct BlockQuoteNode : Node {
   BlockQuoteNode() : Node(NodeType::BlockQuote) {}
-  virtual void print(std::ostream& ost, const std::string& prefix) override {
-    ost << prefix << "<blockquote>" << std::endl;
-    for (auto&& childNode : children) {
-      childNode->print(ost, prefix + "  ");
-    }
-    ost << prefix << "</blockquote>" << std::endl;
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
+    printContainer(this, ost, prefix);
   }
 };
 
+// Paragraph content is kept as inline child nodes (TextNode, InlineCodeNode,
+// EmphasisNode, LinkNode, ImageNode), printed without prefix or newline.
 struct ParagraphNode : Node {
-  ParagraphNode(int index, const std::string& text)
-      : Node(NodeType::Paragraph), index{index}, text{text} {}
-  virtual void print(std::ostream& ost, const std::string& prefix) override {
-    ost << prefix << "<p>" << text << "</p>" << std::endl;
+  ParagraphNode(int index, Node* inlineNode)
+      : Node(NodeType::Paragraph), index{index} {
+    addChild(inlineNode);
+  }
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
+    ost << prefix << "<p>";
+    for (const Node* child : children()) {
+      child->print(ost, prefix);
+    }
+    ost << "</p>" << std::endl;
   }
   int index;
+};
+
+struct TextNode : Node {
+  TextNode(const std::string& text) : Node(NodeType::Text), text{text} {}
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
+    ost << text;
+  }
   std::string text;
 };
 
+struct InlineCodeNode : Node {
+  InlineCodeNode(const std::string& code)
+      : Node(NodeType::InlineCode), code{code} {}
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
+    ost << "<code>" << escape(code) << "</code>";
+  }
+  std::string code;
+};
+
+struct EmphasisNode : Node {
+  EmphasisNode(int level, const std::string& text)
+      : Node(NodeType::Emphasis), level{level}, text{text} {}
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
+    if (level == 1) ost << "<em>" << text << "</em>";
+    if (level == 2) ost << "<strong>" << text << "</strong>";
+    if (level >= 3) ost << "<em><strong>" << text << "</strong></em>";
+  }
+  int level;
+  std::string text;
+};
+
+struct LinkNode : Node {
+  LinkNode(const std::string& url, const std::string& text)
+      : Node(NodeType::Link), url{url}, text{text} {}
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
+    ost << "<a href=\"" << url << "\">" << text << "</a>";
+  }
+  std::string url;
+  std::string text;
+};
+
+struct ImageNode : Node {
+  ImageNode(const std::string& url, const std::string& alt)
+      : Node(NodeType::Image), url{url}, alt{alt} {}
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
+    ost << "<img src=\"" << url << "\" alt=\"" << alt << "\">";
+  }
+  std::string url;
+  std::string alt;
+};
+
 struct OrderedListNode : Node {
   OrderedListNode(int index) : Node(NodeType::OrderedList), index{index} {}
-  virtual void print(std::ostream& ost, const std::string& prefix) override {
-    ost << prefix << "<ol>" << std::endl;
-    for (auto&& childNode : children) {
-      childNode->print(ost, prefix + "  ");
-    }
-    ost << prefix << "</ol>" << std::endl;
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
+    printContainer(this, ost, prefix);
   }
   int index;
 };
 
 struct OrderedListItemNode : Node {
   OrderedListItemNode() : Node(NodeType::OrderedListItem) {}
-  virtual void print(std::ostream& ost, const std::string& prefix) override {
-    ost << prefix << "<li>" << std::endl;
-    if (!children.empty()) children[0]->print(ost, prefix + "  ");
-    ost << prefix << "</li>" << std::endl;
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
+    printContainer(this, ost, prefix);
   }
 };
 
 struct UnorderedListNode : Node {
   UnorderedListNode(int index) : Node(NodeType::UnorderedList), index{index} {}
-  virtual void print(std::ostream& ost, const std::string& prefix) override {
-    ost << prefix << "<ul>" << std::endl;
-    for (auto&& childNode : children) {
-      childNode->print(ost, prefix + "  ");
-    }
-    ost << prefix << "</ul>" << std::endl;
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
+    printContainer(this, ost, prefix);
   }
   int index;
 };
 
 struct UnorderedListItemNode : Node {
   UnorderedListItemNode() : Node(NodeType::UnorderedListItem) {}
-  virtual void print(std::ostream& ost, const std::string& prefix) override {
-    ost << prefix << "<li>" << std::endl;
-    if (!children.empty()) children[0]->print(ost, prefix + "  ");
-    ost << prefix << "</li>" << std::endl;
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
+    printContainer(this, ost, prefix);
   }
 };
 
 struct HorizontalNode : Node {
   HorizontalNode() : Node(NodeType::Horizontal) {}
-  virtual void print(std::ostream& ost, const std::string& prefix) override {
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
     ost << "<hr />" << std::endl;
   }
 };
 
+// `text` is the raw code, escaped when printed.
 struct CodeBlockNode : Node {
   CodeBlockNode(const std::string& text)
       : Node(NodeType::CodeBlock), text{text} {}
-  virtual void print(std::ostream& ost, const std::string& prefix) override {
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
     ost << "<pre><code>";
-    ost << text << std::endl;
+    ost << escape(text) << std::endl;
     ost << "</code></pre>" << std::endl;
   }
   std::string text;
@@ -140,9 +266,82 @@ struct CodeBlockNode : Node {
 
 struct EmptyLineNode : Node {
   EmptyLineNode() : Node(NodeType::EmptyLine) {}
-  virtual void print(std::ostream& ost, const std::string& prefix) override {
+  virtual void print(std::ostream& ost,
+                     const std::string& prefix) const override {
     ost << prefix << "<p><!-- empty --></p>" << std::endl;
   }
 };
 
+// Tag printed around the children of `type`, or nullptr for nodes that
+// print themselves without recursing.
+inline const char* containerTag(NodeType type) {
+  switch (type) {
+    case NodeType::BlockQuote:
+      return "blockquote";
+    case NodeType::OrderedList:
+      return "ol";
+    case NodeType::UnorderedList:
+      return "ul";
+    case NodeType::OrderedListItem:
+    case NodeType::UnorderedListItem:
+      return "li";
+    default:
+      return nullptr;
+  }
+}
+
+inline void printContainer(const Node* node, std::ostream& ost,
+                           const std::string& prefix) {
+  struct Frame {
+    const Node* node;
+    std::size_t next;
+    std::size_t end;
+    bool indented;
+  };
+  std::vector<Frame> stack;
+  std::string indent = prefix;
+
+  while (node) {
+    if (const char* tag = containerTag(node->type)) {
+      ost << indent << "<" << tag << ">" << std::endl;
+      const bool indented = indent.size() < 2 * maxIndentDepth;
+      if (indented) indent += "  ";
+      const bool item = node->type == NodeType::OrderedListItem ||
+                        node->type == NodeType::UnorderedListItem;
+      // list items only print their first child
+      const std::size_t end =
+          item ? std::min<std::size_t>(node->children().size(), 1)
+               : node->children().size();
+      stack.push_back({node, 0, end, indented});
+    } else {
+      node->print(ost, indent);
+    }
+
+    node = nullptr;
+    while (!stack.empty() && !node) {
+      Frame& top = stack.back();
+      if (top.next < top.end) {
+        node = top.node->children()[top.next++];
+      } else {
+        if (top.indented) indent.resize(indent.size() - 2);
+        ost << indent << "</" << containerTag(top.node->type) << ">"
+            << std::endl;
+        stack.pop_back();
+      }
+    }
+  }
+}
+
+// Deletes `node` and everything below it.
+inline void destroyTree(const Node* node) {
+  std::vector<const Node*> pending{node};
+  while (!pending.empty()) {
+    const Node* next = pending.back();
+    pending.pop_back();
+    const ConstChildren children = next->children();
+    pending.insert(pending.end(), children.begin(), children.end());
+    delete next;
+  }
+}
+
 }  // namespace m2h
@@ -1,10 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
 #include <string>
+#include <utility>
 
 #include "../ParsingUtility.hpp"
+#include "../Trace.hpp"
+#include "../limits/Limits.hpp"
 #include "../tokenizer/Token.hpp"
+#include "DocumentIndex.hpp"
 #include "Node.hpp"
 #include "ParsingContext.hpp"
 
@@ -12,19 +17,72 @@ namespace m2h {
 
 using token_iterator = std::vector<Token>::iterator;
 
-class Parser {
+// Token sources that stream their input may drop everything before
+// `it - 1` here, the parser never looks further back than that.
+template <class TokenIterator>
+void releaseConsumed(const TokenIterator &) {}
+
+template <class TokenIterator>
+class BasicParser {
  public:
-  Parser() {}
+  using token_iterator = TokenIterator;
+
+  BasicParser() : index{nullptr}, limits{}, unclosed{false} {}
+
+  // Headings, links and images found while parsing are also recorded into
+  // `index`, with offsets relative to the start of the tokenized input.
+  explicit BasicParser(DocumentIndex *index)
+      : index{index}, limits{}, unclosed{false} {}
+
+  // Node count, nesting depth, deadline and cancellation are checked on
+  // every step; a breach throws LimitExceeded.
+  BasicParser(DocumentIndex *index, const Limits &limits)
+      : index{index}, limits{limits}, unclosed{false} {}
 
   std::vector<Node *> parse(std::vector<Token> &tokens) {
-    Node *root = new RootNode();
+    return parseAll(tokens.begin(), tokens.end());
+  }
+
+  // Parses a part cut out of a longer document, such as a section. The
+  // Eof token only bounds lookahead: at the end of a document it becomes
+  // an empty paragraph, the continuation of a part does not.
+  std::vector<Node *> parsePart(std::vector<Token> &tokens) {
+    return parseAll(tokens.begin(), tokens.end() - 1);
+  }
+
+  // Whether inline or fenced code of the last parse ran into the end of
+  // the tokens unclosed. Within a longer document it would take in what
+  // follows, so a part may then parse differently there.
+  bool unclosedCode() const { return unclosed; }
+
+  // Parses [it, last) into `root`. Every top-level node is passed to
+  // `onBlock` as soon as it is complete, which is the case once the next
+  // top-level node has been started: nothing but the last child of `root`
+  // is ever modified again.
+  template <class Sentinel, class BlockSink>
+  M2H_STAGE void parse(token_iterator it, Sentinel last, Node *root,
+                       BlockSink &&onBlock) {
+    M2H_TRACE0(parse_start);
+    source = it->location;
     context.parent = root;
     context.index = 0;
     context.indent = 0;
-
-    token_iterator it = tokens.begin();
-    while (it != tokens.end()) {
+    context.depth = 0;
+    context.nodes = 0;
+    unclosed = false;
+
+    std::size_t completed = 0;
+    std::ptrdiff_t offset = 0;
+    std::size_t contentEnd = 0;
+    while (it != last) {
+      releaseConsumed(it);
       auto bak = it;
+      offset = it->location - source;
+      limits.checkNodes(context.nodes, offset);
+      limits.checkDepth(context.depth, offset);
+      limits.poll(offset);
+      context.offset = offset;
+      if (it->kind == TokenKind::NewLine) extendSourceRanges(root, contentEnd);
 
       if (parseIndent(it)) {
         goto next;
@@ -114,27 +172,68 @@ class Parser {
       parseParagraph(it);
 
     next:
+      if (it->kind != TokenKind::NewLine) {
+        contentEnd = it->location - source + it->value.size();
+      }
       ++it;
+      while (completed + 1 < root->children().size()) {
+        M2H_TRACE2(block, completed, offset);
+        onBlock(root->children()[completed++]);
+      }
+    }
+    extendSourceRanges(root, contentEnd);
+    limits.checkNow(contentEnd);
+    while (completed < root->children().size()) {
+      M2H_TRACE2(block, completed, offset);
+      onBlock(root->children()[completed++]);
     }
-    return root->children;
+    M2H_TRACE2(parse_end, offset, completed);
   }
 
  private:
+  // The caller owns the returned nodes; when parsing throws, the nodes
+  // parsed so far are freed here.
+  std::vector<Node *> parseAll(token_iterator first, token_iterator last) {
+    RootNode root;
+    try {
+      parse(first, last, &root, [](Node *) {});
+    } catch (...) {
+      for (auto &&node : root.children()) destroyTree(node);
+      throw;
+    }
+    return std::move(root.children());
+  }
+
+  // A line has ended: every block it added to or continued lies on the
+  // path of last children below `root`, and now reaches up to `end`.
+  // Lines nested d levels deep hold at least d tokens, so this stays
+  // linear in the input.
+  static void extendSourceRanges(Node *root, std::size_t end) {
+    Node *node = root->children().empty() ? nullptr : root->children().back();
+    while (node) {
+      node->sourceEnd = std::max(node->sourceEnd, end);
+      const bool container = containerTag(node->type) != nullptr;
+      node = container && !node->children().empty() ? node->children().back()
+                                                  : nullptr;
+    }
+  }
+
   bool parseParagraph(token_iterator &it) {
     auto prevSibling = context.prevSibling();
     if (prevSibling && prevSibling->type == NodeType::Paragraph) {
       auto paragraph = static_cast<ParagraphNode *>(prevSibling);
       if (paragraph->index == context.index) {
-        paragraph->text += "\n" + it->value;
+        context.appendInline(paragraph, new TextNode("\n" + it->value));
         return true;
       }
     }
-    context.append(new ParagraphNode(context.index, it->value));
+    context.append(new ParagraphNode(context.index, new TextNode(it->value)));
     return true;
   }
 
   bool parseHeading(token_iterator &it) {
     if (it->kind != TokenKind::Prefix) return false;
+    const char *loc = it->location;
     int level = 0;
     for (char c : it->value) {
       if (c != '#') break;
@@ -145,6 +244,7 @@ class Parser {
     if (it->kind != TokenKind::Text) return false;
     const std::string value = it->value;
     context.append(new HeadingNode(level, value));
+    if (index) index->addHeading(level, value, loc - source);
     return true;
   }
 
@@ -163,16 +263,20 @@ class Parser {
 
   bool parseNewline(Node *root, token_iterator &it) {
     if (it->kind != TokenKind::NewLine) return false;
-    auto prevToken = it - 1;
-    if (prevToken->value == "> ") {
-      context.append(new EmptyLineNode());
-    }
-    if (prevToken->kind == TokenKind::NewLine) {
-      context.append(new EmptyLineNode());
+    // the first token has no predecessor
+    if (it->location != source) {
+      auto prevToken = it - 1;
+      if (prevToken->value == "> ") {
+        context.append(new EmptyLineNode());
+      }
+      if (prevToken->kind == TokenKind::NewLine) {
+        context.append(new EmptyLineNode());
+      }
     }
     context.parent = root;
     context.index = 0;
     context.indent = 0;
+    context.depth = 0;
     return true;
   }
 
@@ -183,7 +287,10 @@ class Parser {
     auto code = std::string{};
     while (it->kind != TokenKind::BackQuote ||
            (it + 1)->kind != TokenKind::BackQuote) {
-      if ((it + 1)->kind == TokenKind::Eof) return false;
+      if (it->kind == TokenKind::Eof || (it + 1)->kind == TokenKind::Eof) {
+        unclosed = true;
+        return false;
+      }
       code += it->value;
       ++it;
     }
@@ -195,7 +302,7 @@ class Parser {
     auto prevSibling = context.prevSibling();
     if (prevSibling && prevSibling->type == NodeType::Paragraph) {
       auto paragraph = static_cast<ParagraphNode *>(prevSibling);
-      paragraph->text += "<code>" + escape(code) + "</code>";
+      context.appendInline(paragraph, new InlineCodeNode(code));
     }
 
     return true;
@@ -207,7 +314,10 @@ class Parser {
 
     auto code = std::string{};
     while (it->kind != TokenKind::BackQuote) {
-      if (it->kind == TokenKind::Eof) return false;
+      if (it->kind == TokenKind::Eof) {
+        unclosed = true;
+        return false;
+      }
       code += it->value;
       ++it;
     }
@@ -217,16 +327,17 @@ class Parser {
     auto prevSibling = context.prevSibling();
     if (prevSibling && prevSibling->type == NodeType::Paragraph) {
       auto paragraph = static_cast<ParagraphNode *>(prevSibling);
-      paragraph->text += "<code>" + escape(code) + "</code>";
+      context.appendInline(paragraph, new InlineCodeNode(code));
     } else {
-      context.append(new ParagraphNode(context.index,
-                                       "<code>" + escape(code) + "</code>"));
+      context.append(
+          new ParagraphNode(context.index, new InlineCodeNode(code)));
     }
     return true;
   }
 
   bool parseImage(token_iterator &it) {
     if (it->kind != TokenKind::Exclamation) return false;
+    const char *loc = it->location;
     ++it;
 
     if (it->kind != TokenKind::Bracket) return false;
@@ -252,12 +363,13 @@ class Parser {
     if (it->kind != TokenKind::Bracket) return false;
     if (it->value != ")") return false;
 
-    auto link = "<img src=\"" + url + "\" alt=\"" + alt + "\">";
+    auto link = new ImageNode(url, alt);
+    if (index) index->addImage(url, alt, loc - source);
 
     auto prevSibling = context.prevSibling();
     if (prevSibling && prevSibling->type == NodeType::Paragraph) {
       auto paragraph = static_cast<ParagraphNode *>(prevSibling);
-      paragraph->text += link;
+      context.appendInline(paragraph, link);
     } else {
       context.append(new ParagraphNode(context.index, link));
     }
@@ -268,6 +380,7 @@ class Parser {
   bool parseLink(token_iterator &it) {
     if (it->kind != TokenKind::Bracket) return false;
     if (it->value != "[") return false;
+    const char *loc = it->location;
     ++it;
 
     if (it->kind != TokenKind::Text) return false;
@@ -289,12 +402,13 @@ class Parser {
     if (it->kind != TokenKind::Bracket) return false;
     if (it->value != ")") return false;
 
-    auto link = "<a href=\"" + url + "\">" + text + "</a>";
+    auto link = new LinkNode(url, text);
+    if (index) index->addLink(url, text, loc - source);
 
     auto prevSibling = context.prevSibling();
     if (prevSibling && prevSibling->type == NodeType::Paragraph) {
       auto paragraph = static_cast<ParagraphNode *>(prevSibling);
-      paragraph->text += link;
+      context.appendInline(paragraph, link);
     } else {
       context.append(new ParagraphNode(context.index, link));
     }
@@ -311,10 +425,7 @@ class Parser {
     if (c1 == 0) return false;
 
     if (it->kind != TokenKind::Text) return false;
-    auto text = std::string{};
-    if (c1 == 1) text = "<em>" + it->value + "</em>";
-    if (c1 == 2) text = "<strong>" + it->value + "</strong>";
-    if (c1 >= 3) text = "<em><strong>" + it->value + "</strong></em>";
+    auto value = it->value;
     ++it;
 
     for (int i = 0; i < c1; ++i, ++it)
@@ -325,10 +436,11 @@ class Parser {
     if (prevSibling && prevSibling->type == NodeType::Paragraph) {
       auto prevPara = static_cast<ParagraphNode *>(prevSibling);
       if (prevPara->index == context.index) {
-        prevPara->text += text;
+        context.appendInline(prevPara, new EmphasisNode(c1, value));
       }
     } else {
-      context.append(new ParagraphNode(context.index, text));
+      context.append(
+          new ParagraphNode(context.index, new EmphasisNode(c1, value)));
     }
 
     return true;
@@ -346,6 +458,7 @@ class Parser {
       context.append(blockquote);
       context.parent = blockquote;
     }
+    ++context.depth;
     return true;
   }
 
@@ -353,7 +466,7 @@ class Parser {
     if (context.indent < 4) return false;
 
     auto code = std::string{};
-    while (it->kind != TokenKind::NewLine) {
+    while (it->kind != TokenKind::NewLine && it->kind != TokenKind::Eof) {
       code += it->value;
       ++it;
     }
@@ -365,9 +478,9 @@ class Parser {
     auto prevSibling = context.prevSibling();
     if (prevSibling && prevSibling->type == NodeType::CodeBlock) {
       auto codeblock = static_cast<CodeBlockNode *>(prevSibling);
-      codeblock->text += "\n" + escape(code);
+      codeblock->text += "\n" + code;
     } else {
-      context.append(new CodeBlockNode(escape(code)));
+      context.append(new CodeBlockNode(code));
     }
 
     return true;
@@ -383,7 +496,10 @@ class Parser {
 
     auto code = std::string{};
     while (it->kind != TokenKind::BackQuote) {
-      if (it->kind == TokenKind::Eof) return false;
+      if (it->kind == TokenKind::Eof) {
+        unclosed = true;
+        return false;
+      }
       if (it->kind == TokenKind::NewLine)
         code += "\n";
       else
@@ -401,9 +517,9 @@ class Parser {
     auto prevSibling = context.prevSibling();
     if (prevSibling && prevSibling->type == NodeType::CodeBlock) {
       auto codeblock = static_cast<CodeBlockNode *>(prevSibling);
-      codeblock->text += "\n" + escape(code);
+      codeblock->text += "\n" + code;
     } else {
-      context.append(new CodeBlockNode(escape(code)));
+      context.append(new CodeBlockNode(code));
     }
     return true;
   }
@@ -432,12 +548,13 @@ class Parser {
 
       if (currDepth > prevDepth) {
         auto parent = prevlist;
+        ++context.depth;
         for (int i = 1; i < currDepth; ++i) {
-          auto nodes = parent->children;
-          std::reverse(nodes.begin(), nodes.end());
-          for (auto node : nodes) {
-            if (node->type == NodeType::UnorderedList) {
-              parent = static_cast<UnorderedListNode *>(node);
+          auto &nodes = parent->children();
+          for (auto node = nodes.rbegin(); node != nodes.rend(); ++node) {
+            if ((*node)->type == NodeType::UnorderedList) {
+              parent = static_cast<UnorderedListNode *>(*node);
+              ++context.depth;
               break;
             }
           }
@@ -457,11 +574,13 @@ class Parser {
       context.append(unorderedlist);
       context.parent = unorderedlist;
     }
+    ++context.depth;
 
     // li
     auto item = new UnorderedListItemNode();
     context.append(item);
     context.parent = item;
+    ++context.depth;
 
     return true;
   }
@@ -497,12 +616,19 @@ class Parser {
     auto item = new OrderedListItemNode();
     context.append(item);
     context.parent = item;
+    context.depth += 2;
 
     return true;
   }
 
  private:
   ParsingContext context;
+  DocumentIndex *index;
+  LimitChecker limits;
+  bool unclosed;  // see unclosedCode()
+  const char *source;
 };
 
+using Parser = BasicParser<token_iterator>;
+
 }  // namespace m2h
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 #include "Node.hpp"
 
 namespace m2h {
@@ -8,13 +10,26 @@ struct ParsingContext {
   Node *parent;
   int index;
   int indent;
+  std::size_t depth;  // containers between the root and `parent`
+  std::size_t nodes;  // nodes created so far
+  std::size_t offset;  // input offset of the current parsing step
 
   Node *prevSibling() {
-    auto children = parent->children;
+    auto &children = parent->children();
     return children.empty() ? nullptr : children.back();
   }
 
-  void append(Node *node) { parent->children.push_back(node); }
+  // `node` is new and holds at most its first inline child
+  void append(Node *node) {
+    node->sourceBegin = node->sourceEnd = offset;
+    parent->children().push_back(node);
+    nodes += 1 + node->children().size();
+  }
+
+  void appendInline(Node *paragraph, Node *node) {
+    paragraph->addChild(node);
+    ++nodes;
+  }
 };
 
 }  // namespace m2h
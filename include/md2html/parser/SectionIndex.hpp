@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../ParsingUtility.hpp"
+#include "../tokenizer/Tokenizer.hpp"
+#include "DocumentIndex.hpp"
+#include "LineIndex.hpp"
+#include "Parser.hpp"
+
+namespace m2h {
+
+struct SectionEntry {
+  int level;
+  std::string text;
+  std::string anchor;
+  std::size_t begin;   // byte offset of the heading prefix
+  std::size_t end;     // next heading of the same or a higher level, or EOF
+  std::size_t line;    // 1-based line of the heading
+  std::size_t column;  // 1-based byte column of the heading prefix
+};
+
+// Offsets of the top-level headings of a document and the sections they
+// open, usually found without tokenizing or parsing all of it: the input
+// is scanned with memchr, and each line holding a '#' or a '`' is
+// tokenized and parsed on its own, so Parser decides what is a heading.
+// The tokenizer and the buffers are kept from one line to the next, so a
+// line costs its own tokens and nodes only. That is where the scan saves
+// time: when nearly every line holds a '#' or a '`', it costs about as
+// much as parsing the whole document.
+// A line parses the same on its own as in the document unless something
+// carries over from the lines before it: code that Parser finds unclosed
+// at the end of the line runs on into the next ones, and a list item
+// indented by four columns is only a list item after another list. Fenced
+// code between "```" lines is skipped the way Parser reads it, up to the
+// next backquote; on anything else that may carry over, the whole
+// document is parsed instead. Anchors follow DocumentIndex, counted over
+// every heading, including those in block quotes and lists.
+//
+// A section [begin, end) parses on its own to the same nodes it has in
+// the whole document, so serving one costs the scan plus its own size.
+class SectionIndex {
+ public:
+  SectionIndex(const char* data, std::size_t size)
+      : entries{}, open{}, scanned_{true} {
+    if (!scan(data, size)) {
+      entries.clear();
+      open.clear();
+      scanned_ = false;
+      parseAll(data, size);
+    }
+  }
+
+  const std::vector<SectionEntry>& sections() const { return entries; }
+
+  // Whether the scan found the headings, rather than a full parse.
+  bool scanned() const { return scanned_; }
+
+  // `key` is an anchor or, failing that, the 0-based position of the
+  // heading in sections(). Returns nullptr if there is no such section.
+  const SectionEntry* find(const std::string& key) const {
+    for (auto&& entry : entries) {
+      if (entry.anchor == key) return &entry;
+    }
+    if (key.empty() || !std::all_of(key.begin(), key.end(), isDigit)) {
+      return nullptr;
+    }
+    const std::size_t i = std::strtoull(key.c_str(), nullptr, 10);
+    return i < entries.size() ? &entries[i] : nullptr;
+  }
+
+ private:
+  // Jumps from one '#' or '`' to the next and handles the line it is in.
+  // Returns false where a line may parse differently in the document.
+  bool scan(const char* data, std::size_t size) {
+    LineParser lineParser;
+    const char* p = data;
+    const char* last = data + size;
+    const char* hash = data;
+    const char* tick = data;
+    const char* counted = data;  // newlines before here are in `line`
+    std::size_t line = 1;
+    while (true) {
+      if (hash < p) hash = find(p, last, '#');
+      if (tick < p) tick = find(p, last, '`');
+      const char* c = std::min(hash, tick);
+      if (c == last) break;
+      const char* begin = c;
+      while (begin != p && !isCrlf(begin[-1])) --begin;
+      const char* eol = lineEnd(c, last);
+      const char* next = nextLine(eol, last);
+      if (tick < eol && begin == tick && isFence(tick, eol)) {
+        // Parser::parseCodeBlock2 ends the block at the next backquote
+        const char* close = find(next, last, '`');
+        if (close == last || !isCrlf(close[-1])) return false;
+        const char* closeEol = lineEnd(close, last);
+        if (!isFence(close, closeEol)) return false;
+        p = nextLine(closeEol, last);
+        continue;
+      }
+      line += LineIndex::newlines(counted, begin - counted);
+      counted = begin;
+      if (!parseLine(lineParser, data, begin, next, line)) {
+        return false;
+      }
+      p = next;
+    }
+    closeSections(0, size);
+    return true;
+  }
+
+  // What parsing a single line needs, reused for every line of a scan.
+  // `index` holds the headings of the last line only, but numbers their
+  // anchors over all the lines before it.
+  struct LineParser {
+    std::string text;
+    Tokenizer tokenizer;
+    DocumentIndex index;
+    std::vector<std::size_t> top;  // offsets of the top-level headings
+  };
+
+  // Parses the line [begin, end) by itself and adds its headings.
+  bool parseLine(LineParser& lp, const char* data, const char* begin,
+                 const char* end, std::size_t line) {
+    lp.text.assign(begin, end - begin);
+    std::replace(lp.text.begin(), lp.text.end(), '\0', '\x1a');
+    lp.tokenizer.clear();
+    const std::vector<Token>& tokens =
+        lp.tokenizer.tokenize(lp.text.c_str(), lp.text.size());
+    std::size_t indent = 0;  // as Parser counts context.indent
+    for (auto token = tokens.begin(); token != tokens.end(); ++token) {
+      if (token->kind == TokenKind::Indent) indent += token->value.size();
+      if (token->kind != TokenKind::Prefix || token->value[0] == '#') continue;
+      if (oneof(token->value[0], "*+-") && indent >= 4) {
+        // a list item after a list, code otherwise: the same unless the
+        // rest of the line holds a heading or a backquote
+        if (std::any_of(token + 1, tokens.end(), headingOrCode)) return false;
+      }
+      indent = 0;
+    }
+    // e.g. a '#' in a url
+    if (std::none_of(tokens.begin(), tokens.end(), headingOrCode)) return true;
+    lp.index.headings.clear();
+    lp.index.links.clear();
+    lp.index.images.clear();
+    lp.top.clear();
+    // Parser only reads the tokens, so it takes them where they are
+    BasicParser<std::vector<Token>::const_iterator> parser(&lp.index);
+    RootNode root;
+    parser.parse(tokens.begin(), tokens.end(), &root, [&](Node* node) {
+      if (node->type == NodeType::Heading) lp.top.push_back(node->sourceBegin);
+      destroyTree(node);
+    });
+    if (parser.unclosedCode()) return false;
+    for (auto&& heading : lp.index.headings) {
+      if (std::binary_search(lp.top.begin(), lp.top.end(), heading.offset)) {
+        addSection(heading.level, heading.text, heading.anchor,
+                   begin - data + heading.offset, line, heading.offset + 1);
+      }
+    }
+    return true;
+  }
+
+  void parseAll(const char* data, std::size_t size) {
+    const std::string text = withoutNul(data, size);
+    Tokenizer tokenizer;
+    std::vector<Token> tokens = tokenizer.tokenize(text.c_str(), text.size());
+    DocumentIndex index;
+    Parser parser(&index);
+    const std::vector<std::size_t> top = topLevelHeadings(parser, tokens);
+    const LineIndex lines(data, size);
+    for (auto&& heading : index.headings) {
+      if (!std::binary_search(top.begin(), top.end(), heading.offset)) {
+        continue;
+      }
+      const SourcePosition position = lines.position(heading.offset);
+      addSection(heading.level, heading.text, heading.anchor, heading.offset,
+                 position.line, position.column);
+    }
+    closeSections(0, size);
+  }
+
+  void addSection(int level, const std::string& text,
+                  const std::string& anchor, std::size_t begin,
+                  std::size_t line, std::size_t column) {
+    closeSections(level, begin);
+    open.push_back(entries.size());
+    entries.push_back({level, text, anchor, begin, begin, line, column});
+  }
+
+  // Ends the open sections of `level` or deeper at `end`.
+  void closeSections(int level, std::size_t end) {
+    while (!open.empty() && entries[open.back()].level >= level) {
+      entries[open.back()].end = end;
+      open.pop_back();
+    }
+  }
+
+  // Parses `tokens`; returns the offsets of the headings that are
+  // top-level blocks, in order.
+  static std::vector<std::size_t> topLevelHeadings(Parser& parser,
+                                                   std::vector<Token>& tokens) {
+    std::vector<std::size_t> offsets;
+    for (auto&& node : parser.parse(tokens)) {
+      if (node->type == NodeType::Heading) offsets.push_back(node->sourceBegin);
+      destroyTree(node);
+    }
+    return offsets;
+  }
+
+  // a token Parser may start a heading or code with
+  static bool headingOrCode(const Token& token) {
+    return token.kind == TokenKind::BackQuote ||
+           (token.kind == TokenKind::Prefix && token.value[0] == '#');
+  }
+
+  // Tokenizer stops at NUL; the converter sees a replacement character
+  // there, which tokenizes like any other text byte.
+  static std::string withoutNul(const char* p, std::size_t size) {
+    std::string text{p, size};
+    std::replace(text.begin(), text.end(), '\0', '\x1a');
+    return text;
+  }
+
+  // the first `c` in [p, last), or `last`
+  static const char* find(const char* p, const char* last, char c) {
+    auto found = static_cast<const char*>(std::memchr(p, c, last - p));
+    return found ? found : last;
+  }
+
+  // The '\n' or '\r' ending the line of p, or `last`. Tokenizer also ends
+  // a line at a '\r' on its own.
+  static const char* lineEnd(const char* p, const char* last) {
+    const char* lf = find(p, last, '\n');
+    return find(p, lf, '\r');
+  }
+
+  // the start of the line after the one ended at `eol`
+  static const char* nextLine(const char* eol, const char* last) {
+    if (eol == last) return last;
+    return eol[0] == '\r' && eol + 1 != last && eol[1] == '\n' ? eol + 2
+                                                             : eol + 1;
+  }
+
+  static bool isFence(const char* p, const char* eol) {
+    return eol - p == 3 && std::memcmp(p, "```", 3) == 0;
+  }
+
+  std::vector<SectionEntry> entries;
+  std::vector<std::size_t> open;  // sections not yet ended
+  bool scanned_;
+};
+
+}  // namespace m2h
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../limits/Limits.hpp"
+#include "../parser/DocumentIndex.hpp"
+#include "../parser/Parser.hpp"
+#include "../tokenizer/Tokenizer.hpp"
+#include "SpscQueue.hpp"
+#include "TokenStream.hpp"
+
+namespace m2h {
+
+struct PipelineOptions {
+  std::size_t tokenBatchSize = 4096;  // tokens per batch
+  std::size_t tokenBatches = 8;       // batches in flight
+  std::size_t nodes = 256;            // completed top-level nodes in flight
+};
+
+// Runs tokenizer, parser and `emit` on three threads connected by bounded
+// SPSC queues. The tokenizer publishes token batches to the parser, the
+// parser hands over each top-level node once it is complete, and `emit`
+// is called with those nodes, in document order, on the calling thread.
+// [p, p + size) is handed to Tokenizer as is, see its requirements.
+//
+// The first exception thrown by any stage (e.g. LimitExceeded) sets a stop
+// flag the other stages poll along with their Limits, so they give up
+// within a few steps instead of finishing the document; the stages behind
+// the failed one drain their input so nobody stays blocked on a full
+// queue, and that first exception is rethrown on the calling thread.
+template <class Emit>
+void runPipeline(const char* p, std::size_t size, DocumentIndex* index,
+                 Emit&& emit, const PipelineOptions& options = PipelineOptions{},
+                 const Limits& limits = Limits{}) {
+  TokenStream tokens(options.tokenBatches);
+  SpscQueue<Node*> nodes(options.nodes);
+  std::atomic<bool> stop{false};
+  std::mutex errorMutex;
+  std::exception_ptr error;
+  const auto fail = [&](std::exception_ptr e) {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (!error) error = e;
+    stop.store(true, std::memory_order_relaxed);
+  };
+  Limits stageLimits = limits;
+  stageLimits.stop = &stop;
+
+  std::thread tokenizerThread([&] {
+    try {
+      Tokenizer tokenizer(stageLimits);
+      tokenizer.tokenize(p, size, options.tokenBatchSize,
+                         [&](std::vector<Token>&& batch) {
+                           tokens.publish(std::move(batch));
+                         });
+    } catch (...) {
+      fail(std::current_exception());
+    }
+    tokens.close();
+  });
+
+  std::thread parserThread([&] {
+    try {
+      BasicParser<TokenStreamIterator> parser(index, stageLimits);
+      RootNode root;
+      parser.parse(TokenStreamIterator(&tokens, 0), TokenStreamEnd{}, &root,
+                   [&](Node* node) { nodes.push(std::move(node)); });
+    } catch (...) {
+      fail(std::current_exception());
+      tokens.drain();
+    }
+    nodes.close();
+  });
+
+  Node* node = nullptr;
+  while (nodes.pop(node)) {
+    if (stop.load(std::memory_order_relaxed)) {
+      destroyTree(node);
+      continue;
+    }
+    try {
+      emit(node);
+    } catch (...) {
+      fail(std::current_exception());
+    }
+  }
+
+  tokenizerThread.join();
+  parserThread.join();
+  if (error) std::rethrow_exception(error);
+}
+
+}  // namespace m2h
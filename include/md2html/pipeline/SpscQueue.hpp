@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace m2h {
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// push() waits while the queue is full, which is what keeps a fast stage
+// from running arbitrarily far ahead of a slow one.
+template <class T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(std::size_t capacity)
+      : slots(roundUp(capacity)), mask{slots.size() - 1}, head{0}, tail{0},
+        closed{false} {}
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  bool tryPush(T&& value) {
+    const std::size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == slots.size()) return false;
+    slots[t & mask] = std::move(value);
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  void push(T&& value) {
+    for (int spins = 0; !tryPush(std::move(value)); ++spins) backoff(spins);
+  }
+
+  bool tryPop(T& value) {
+    const std::size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) return false;
+    value = std::move(slots[h & mask]);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Waits for the next element. Returns false once the producer has
+  // called close() and everything pushed before has been popped.
+  bool pop(T& value) {
+    for (int spins = 0;; ++spins) {
+      if (tryPop(value)) return true;
+      if (closed.load(std::memory_order_acquire)) return tryPop(value);
+      backoff(spins);
+    }
+  }
+
+  void close() { closed.store(true, std::memory_order_release); }
+
+ private:
+  static std::size_t roundUp(std::size_t n) {
+    std::size_t size = 2;
+    while (size < n) size <<= 1;
+    return size;
+  }
+
+  static void backoff(int spins) {
+    if (spins >= 64) std::this_thread::yield();
+  }
+
+  std::vector<T> slots;
+  const std::size_t mask;
+  alignas(64) std::atomic<std::size_t> head;
+  alignas(64) std::atomic<std::size_t> tail;
+  alignas(64) std::atomic<bool> closed;
+};
+
+}  // namespace m2h
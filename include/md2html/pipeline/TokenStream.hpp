@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "../tokenizer/Token.hpp"
+#include "SpscQueue.hpp"
+
+namespace m2h {
+
+// Token batches travelling from the tokenizer thread to the parser thread.
+//
+// The producer side is publish()/close(). On the consumer side the parser
+// sees one contiguous token sequence through TokenStreamIterator: batches
+// are pulled from the queue on demand when the parser looks ahead, and
+// dropped again once the parser has moved past them.
+class TokenStream {
+ public:
+  explicit TokenStream(std::size_t capacity)
+      : queue{capacity}, window{}, windowBegin{0}, windowEnd{0},
+        eof{TokenKind::Eof, "", nullptr} {}
+
+  void publish(std::vector<Token>&& batch) { queue.push(std::move(batch)); }
+  void close() { queue.close(); }
+
+  // Discards everything until the producer closes the stream, so that a
+  // consumer giving up early does not leave the producer blocked.
+  void drain() {
+    window.clear();
+    std::vector<Token> batch;
+    while (queue.pop(batch)) {
+    }
+  }
+
+  // Positions past the end of the stream read as Eof.
+  Token& at(std::size_t index) {
+    while (index >= windowEnd) {
+      if (!fetch()) return eof;
+    }
+    std::size_t begin = windowBegin;
+    for (auto&& batch : window) {
+      if (index < begin + batch.size()) return batch[index - begin];
+      begin += batch.size();
+    }
+    return eof;
+  }
+
+  bool exhausted(std::size_t index) {
+    while (index >= windowEnd) {
+      if (!fetch()) return true;
+    }
+    return false;
+  }
+
+  // Drops the batches that lie entirely before `index`.
+  void release(std::size_t index) {
+    while (!window.empty() && windowBegin + window.front().size() <= index) {
+      windowBegin += window.front().size();
+      window.pop_front();
+    }
+  }
+
+ private:
+  bool fetch() {
+    std::vector<Token> batch;
+    if (!queue.pop(batch)) return false;
+    windowEnd += batch.size();
+    window.push_back(std::move(batch));
+    return true;
+  }
+
+  SpscQueue<std::vector<Token>> queue;
+  std::deque<std::vector<Token>> window;
+  std::size_t windowBegin;
+  std::size_t windowEnd;
+  Token eof;
+};
+
+struct TokenStreamEnd {};
+
+class TokenStreamIterator {
+ public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = Token;
+  using difference_type = std::ptrdiff_t;
+  using pointer = Token*;
+  using reference = Token&;
+
+  TokenStreamIterator(TokenStream* stream, std::size_t index)
+      : stream{stream}, index{index} {}
+
+  Token& operator*() const { return stream->at(index); }
+  Token* operator->() const { return &stream->at(index); }
+
+  TokenStreamIterator& operator++() {
+    ++index;
+    return *this;
+  }
+  TokenStreamIterator& operator--() {
+    --index;
+    return *this;
+  }
+  TokenStreamIterator operator+(difference_type n) const {
+    return {stream, index + n};
+  }
+  TokenStreamIterator operator-(difference_type n) const {
+    return {stream, index - n};
+  }
+
+  bool operator==(const TokenStreamIterator& rhs) const {
+    return index == rhs.index;
+  }
+  bool operator!=(const TokenStreamIterator& rhs) const {
+    return index != rhs.index;
+  }
+  bool operator!=(TokenStreamEnd) const { return !stream->exhausted(index); }
+
+  std::size_t position() const { return index; }
+  TokenStream* source() const { return stream; }
+
+ private:
+  TokenStream* stream;
+  std::size_t index;
+};
+
+// Called by the parser before each top-level step; it never looks further
+// back than the previous token, so older batches can be freed.
+inline void releaseConsumed(const TokenStreamIterator& it) {
+  if (it.position() > 0) it.source()->release(it.position() - 1);
+}
+
+}  // namespace m2h
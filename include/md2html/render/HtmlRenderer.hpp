@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+#include "../ParsingUtility.hpp"
+#include "../parser/EventParser.hpp"
+#include "../parser/LineIndex.hpp"
+#include "../parser/Node.hpp"
+
+namespace m2h {
+
+// Event handler producing the same html as Node::print. Given a LineIndex
+// of the input, every block element also gets a
+// data-sourcepos="line:column-line:column" attribute (inclusive range).
+class HtmlRenderer : public EventHandler {
+ public:
+  explicit HtmlRenderer(std::ostream& ost, const LineIndex* lines = nullptr)
+      : ost{ost}, prefix{}, depth{0}, inCodeBlock{false}, lines{lines},
+        sourceBegin{0}, sourceEnd{0} {}
+
+  void blockSource(std::size_t begin, std::size_t end) {
+    sourceBegin = begin;
+    sourceEnd = end;
+  }
+
+  void enterBlock(NodeType type, int level) {
+    switch (type) {
+      case NodeType::Heading:
+        ost << prefix << "<h" << level;
+        sourcepos();
+        ost << ">";
+        break;
+      case NodeType::Paragraph:
+        ost << prefix << "<p";
+        sourcepos();
+        ost << ">";
+        break;
+      case NodeType::BlockQuote:
+        open("blockquote");
+        break;
+      case NodeType::OrderedList:
+        open("ol");
+        break;
+      case NodeType::UnorderedList:
+        open("ul");
+        break;
+      case NodeType::OrderedListItem:
+      case NodeType::UnorderedListItem:
+        open("li");
+        break;
+      case NodeType::Horizontal:
+        ost << "<hr";
+        sourcepos();
+        ost << " />" << std::endl;
+        break;
+      case NodeType::CodeBlock:
+        ost << "<pre";
+        sourcepos();
+        ost << "><code>";
+        inCodeBlock = true;
+        break;
+      case NodeType::EmptyLine:
+        ost << prefix << "<p";
+        sourcepos();
+        ost << "><!-- empty --></p>" << std::endl;
+        break;
+      default:
+        break;
+    }
+  }
+
+  void exitBlock(NodeType type, int level) {
+    switch (type) {
+      case NodeType::Heading:
+        ost << "</h" << level << ">" << std::endl;
+        break;
+      case NodeType::Paragraph:
+        ost << "</p>" << std::endl;
+        break;
+      case NodeType::BlockQuote:
+        close("</blockquote>");
+        break;
+      case NodeType::OrderedList:
+        close("</ol>");
+        break;
+      case NodeType::UnorderedList:
+        close("</ul>");
+        break;
+      case NodeType::OrderedListItem:
+      case NodeType::UnorderedListItem:
+        close("</li>");
+        break;
+      case NodeType::CodeBlock:
+        ost << std::endl << "</code></pre>" << std::endl;
+        inCodeBlock = false;
+        break;
+      default:
+        break;
+    }
+  }
+
+  void text(const std::string& text) { ost << text; }
+
+  void code(const std::string& code) {
+    if (inCodeBlock) {
+      ost << escape(code);
+    } else {
+      ost << "<code>" << escape(code) << "</code>";
+    }
+  }
+
+  void emphasis(int level, const std::string& text) {
+    if (level == 1) ost << "<em>" << text << "</em>";
+    if (level == 2) ost << "<strong>" << text << "</strong>";
+    if (level >= 3) ost << "<em><strong>" << text << "</strong></em>";
+  }
+
+  void link(const std::string& url, const std::string& text) {
+    ost << "<a href=\"" << url << "\">" << text << "</a>";
+  }
+
+  void image(const std::string& url, const std::string& alt) {
+    ost << "<img src=\"" << url << "\" alt=\"" << alt << "\">";
+  }
+
+ private:
+  void sourcepos() {
+    if (!lines) return;
+    const SourcePosition begin = lines->position(sourceBegin);
+    const SourcePosition end =
+        lines->position(sourceEnd > sourceBegin ? sourceEnd - 1 : sourceBegin);
+    // room for the prefix, four 20 digit numbers and their separators
+    char buf[128] = " data-sourcepos=\"";
+    char* p = buf + 17;
+    p = writeNumber(p, begin.line);
+    *p++ = ':';
+    p = writeNumber(p, begin.column);
+    *p++ = '-';
+    p = writeNumber(p, end.line);
+    *p++ = ':';
+    p = writeNumber(p, end.column);
+    *p++ = '"';
+    ost.write(buf, p - buf);
+  }
+
+  static char* writeNumber(char* p, std::size_t n) {
+    char digits[20];
+    int count = 0;
+    do {
+      digits[count++] = static_cast<char>('0' + n % 10);
+      n /= 10;
+    } while (n != 0);
+    while (count > 0) *p++ = digits[--count];
+    return p;
+  }
+
+  void open(const char* name) {
+    ost << prefix << "<" << name;
+    sourcepos();
+    ost << ">" << std::endl;
+    if (depth++ < maxIndentDepth) prefix += "  ";
+  }
+
+  void close(const char* tag) {
+    if (--depth < maxIndentDepth) prefix.resize(prefix.size() - 2);
+    ost << prefix << tag << std::endl;
+  }
+
+  std::ostream& ost;
+  std::string prefix;
+  std::size_t depth;
+  bool inCodeBlock;
+  const LineIndex* lines;
+  std::size_t sourceBegin;
+  std::size_t sourceEnd;
+};
+
+}  // namespace m2h
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../parser/EventParser.hpp"
+#include "../parser/Node.hpp"
+
+namespace m2h {
+
+// Run-time polymorphic event handler, so that the set of outputs can be
+// chosen at run time and attached to a single MultiRenderer.
+struct Renderer {
+  virtual ~Renderer() = default;
+  virtual void blockSource(std::size_t begin, std::size_t end) = 0;
+  virtual void enterBlock(NodeType type, int level) = 0;
+  virtual void exitBlock(NodeType type, int level) = 0;
+  virtual void text(const std::string& text) = 0;
+  virtual void code(const std::string& code) = 0;
+  virtual void emphasis(int level, const std::string& text) = 0;
+  virtual void link(const std::string& url, const std::string& text) = 0;
+  virtual void image(const std::string& url, const std::string& alt) = 0;
+  virtual void finish() = 0;
+};
+
+// Wraps any EventHandler as a Renderer. finish() is forwarded to handlers
+// that buffer their output (see SummaryRenderer).
+template <class Handler>
+class RendererFor : public Renderer {
+ public:
+  template <class... Args>
+  explicit RendererFor(Args&&... args) : handler(std::forward<Args>(args)...) {}
+
+  void blockSource(std::size_t begin, std::size_t end) override {
+    handler.blockSource(begin, end);
+  }
+  void enterBlock(NodeType type, int level) override {
+    handler.enterBlock(type, level);
+  }
+  void exitBlock(NodeType type, int level) override {
+    handler.exitBlock(type, level);
+  }
+  void text(const std::string& text) override { handler.text(text); }
+  void code(const std::string& code) override { handler.code(code); }
+  void emphasis(int level, const std::string& text) override {
+    handler.emphasis(level, text);
+  }
+  void link(const std::string& url, const std::string& text) override {
+    handler.link(url, text);
+  }
+  void image(const std::string& url, const std::string& alt) override {
+    handler.image(url, alt);
+  }
+  void finish() override { finish(handler, 0); }
+
+ private:
+  template <class H>
+  static auto finish(H& h, int) -> decltype(h.finish(), void()) {
+    h.finish();
+  }
+  template <class H>
+  static void finish(H&, long) {}
+
+  Handler handler;
+};
+
+// Forwards every event of one traversal to all attached renderers, each
+// writing to its own sink.
+class MultiRenderer : public EventHandler {
+ public:
+  MultiRenderer() : renderers{} {}
+
+  void attach(Renderer* renderer) { renderers.push_back(renderer); }
+
+  void blockSource(std::size_t begin, std::size_t end) {
+    for (auto&& r : renderers) r->blockSource(begin, end);
+  }
+  void enterBlock(NodeType type, int level) {
+    for (auto&& r : renderers) r->enterBlock(type, level);
+  }
+  void exitBlock(NodeType type, int level) {
+    for (auto&& r : renderers) r->exitBlock(type, level);
+  }
+  void text(const std::string& text) {
+    for (auto&& r : renderers) r->text(text);
+  }
+  void code(const std::string& code) {
+    for (auto&& r : renderers) r->code(code);
+  }
+  void emphasis(int level, const std::string& text) {
+    for (auto&& r : renderers) r->emphasis(level, text);
+  }
+  void link(const std::string& url, const std::string& text) {
+    for (auto&& r : renderers) r->link(url, text);
+  }
+  void image(const std::string& url, const std::string& alt) {
+    for (auto&& r : renderers) r->image(url, alt);
+  }
+  void finish() {
+    for (auto&& r : renderers) r->finish();
+  }
+
+ private:
+  std::vector<Renderer*> renderers;
+};
+
+}  // namespace m2h
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+#include "../parser/EventParser.hpp"
+#include "../parser/Node.hpp"
+
+namespace m2h {
+
+// Event handler writing the visible text only: no markup, one line per
+// heading, paragraph and code block line, link texts and image alts
+// instead of the links and images.
+class PlainTextRenderer : public EventHandler {
+ public:
+  explicit PlainTextRenderer(std::ostream& ost) : ost{ost} {}
+
+  void exitBlock(NodeType type, int /*level*/) {
+    switch (type) {
+      case NodeType::Heading:
+      case NodeType::Paragraph:
+      case NodeType::CodeBlock:
+      case NodeType::EmptyLine:
+        ost << '\n';
+        break;
+      default:
+        break;
+    }
+  }
+
+  void text(const std::string& text) { ost << text; }
+  void code(const std::string& code) { ost << code; }
+  void emphasis(int /*level*/, const std::string& text) { ost << text; }
+  void link(const std::string& /*url*/, const std::string& text) {
+    ost << text;
+  }
+  void image(const std::string& /*url*/, const std::string& alt) {
+    ost << alt;
+  }
+
+ private:
+  std::ostream& ost;
+};
+
+}  // namespace m2h
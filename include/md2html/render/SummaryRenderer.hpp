@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+#include "../ParsingUtility.hpp"
+#include "../parser/EventParser.hpp"
+#include "../parser/Node.hpp"
+
+namespace m2h {
+
+// Event handler collecting the first `limit` characters (UTF-8 code points)
+// of paragraph text, with whitespace collapsed. Headings and code blocks
+// are skipped. A cut summary ends at a word boundary followed by "...",
+// which counts towards `limit`. Once the summary is full all further
+// events are ignored; it is written to `ost` by finish().
+class SummaryRenderer : public EventHandler {
+ public:
+  explicit SummaryRenderer(std::ostream& ost, std::size_t limit = 200)
+      : ost{ost}, limit{limit}, summary{}, length{0}, paragraph{false},
+        full{false} {}
+
+  void enterBlock(NodeType type, int /*level*/) {
+    if (type == NodeType::Paragraph) paragraph = true;
+  }
+
+  void exitBlock(NodeType type, int /*level*/) {
+    if (type == NodeType::Paragraph) {
+      append(" ");
+      paragraph = false;
+    }
+  }
+
+  void text(const std::string& text) { append(text); }
+  void code(const std::string& code) { append(code); }
+  void emphasis(int /*level*/, const std::string& text) { append(text); }
+  void link(const std::string& /*url*/, const std::string& text) {
+    append(text);
+  }
+  void image(const std::string& /*url*/, const std::string& /*alt*/) {}
+
+  void finish() {
+    if (full) {
+      // leave room for the "..."
+      std::size_t cut = offsetOf(limit > 3 ? limit - 3 : 0);
+      if (cut < summary.size() && summary[cut] != ' ') {
+        // the cut falls inside a word, which is dropped
+        const auto space = summary.rfind(' ', cut);
+        if (space != std::string::npos && space > 0) cut = space;
+      }
+      summary.resize(cut);
+    }
+    while (!summary.empty() && summary.back() == ' ') summary.pop_back();
+    if (full) summary += "...";
+    ost << summary << std::endl;
+  }
+
+ private:
+  void append(const std::string& s) {
+    if (!paragraph || full) return;
+    for (char c : s) {
+      const bool space = isSpace(c) || isCrlf(c);
+      if (space && (summary.empty() || summary.back() == ' ')) continue;
+      const bool continuation = (static_cast<unsigned char>(c) & 0xc0) == 0x80;
+      if (!continuation) {
+        // a space after the last character would be trimmed anyway
+        if (length == limit && space) continue;
+        if (length == limit) {
+          full = true;
+          return;
+        }
+        ++length;
+      }
+      summary += space ? ' ' : c;
+    }
+  }
+
+  // byte offset of the `n`th code point of the summary
+  std::size_t offsetOf(std::size_t n) const {
+    std::size_t i = 0;
+    for (; i < summary.size(); ++i) {
+      const bool continuation =
+          (static_cast<unsigned char>(summary[i]) & 0xc0) == 0x80;
+      if (!continuation && n-- == 0) break;
+    }
+    return i;
+  }
+
+  std::ostream& ost;
+  std::size_t limit;
+  std::string summary;
+  std::size_t length;
+  bool paragraph;
+  bool full;
+};
+
+}  // namespace m2h
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <malloc.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace m2h {
+
+struct AllocationStats {
+  std::uint64_t allocations;
+  std::uint64_t bytes;      // total bytes allocated
+  std::uint64_t liveBytes;  // currently allocated
+  std::uint64_t peakBytes;  // highest liveBytes since the last resetPeak()
+};
+
+namespace detail {
+inline std::atomic<std::uint64_t> allocations{0};
+inline std::atomic<std::uint64_t> allocatedBytes{0};
+inline std::atomic<std::uint64_t> liveBytes{0};
+inline std::atomic<std::uint64_t> peakBytes{0};
+
+inline void* countedAlloc(std::size_t n) {
+  void* p = std::malloc(n == 0 ? 1 : n);
+  if (!p) return nullptr;
+  const std::uint64_t size = malloc_usable_size(p);
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  const std::uint64_t live =
+      liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+  std::uint64_t peak = peakBytes.load(std::memory_order_relaxed);
+  while (live > peak && !peakBytes.compare_exchange_weak(
+                            peak, live, std::memory_order_relaxed)) {
+  }
+  return p;
+}
+
+inline void countedFree(void* p) {
+  if (!p) return;
+  liveBytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+  std::free(p);
+}
+}  // namespace detail
+
+// True when built with MD2HTML_ALLOCATION_STATS, i.e. when the global
+// operator new/delete below replace the default ones.
+#ifdef MD2HTML_ALLOCATION_STATS
+constexpr bool allocationStatsEnabled = true;
+#else
+constexpr bool allocationStatsEnabled = false;
+#endif
+
+inline AllocationStats allocationStats() {
+  return {detail::allocations.load(), detail::allocatedBytes.load(),
+          detail::liveBytes.load(), detail::peakBytes.load()};
+}
+
+// Starts a new peak measurement from the current live bytes.
+inline void resetPeak() { detail::peakBytes.store(detail::liveBytes.load()); }
+
+struct StageAllocations {
+  std::string stage;
+  std::uint64_t allocations;
+  std::uint64_t bytes;
+  std::uint64_t peakBytes;  // peak live bytes above the stage's start
+};
+
+// Upper bounds for one stage, relative to the input size in KiB.
+struct AllocationBudget {
+  std::string stage;
+  double allocationsPerKiB;
+  double peakBytesPerKiB;
+};
+
+// Records the allocations of consecutive stages (begin/end pairs).
+class AllocationProfile {
+ public:
+  AllocationProfile() : stages{}, current{}, start{} {}
+
+  void begin(const std::string& stage) {
+    current = stage;
+    start = allocationStats();
+    resetPeak();
+  }
+
+  void end() {
+    const AllocationStats now = allocationStats();
+    stages.push_back({current, now.allocations - start.allocations,
+                      now.bytes - start.bytes,
+                      now.peakBytes - start.liveBytes});
+  }
+
+  std::vector<StageAllocations> stages;
+
+ private:
+  std::string current;
+  AllocationStats start;
+};
+
+}  // namespace m2h
+
+#ifdef MD2HTML_ALLOCATION_STATS
+// Replacements of the global allocation functions. Like the non-inline
+// helpers in ParsingUtility.hpp, this must be included by one translation
+// unit only.
+void* operator new(std::size_t n) {
+  if (void* p = m2h::detail::countedAlloc(n)) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t n) {
+  if (void* p = m2h::detail::countedAlloc(n)) return p;
+  throw std::bad_alloc();
+}
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept {
+  return m2h::detail::countedAlloc(n);
+}
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept {
+  return m2h::detail::countedAlloc(n);
+}
+void operator delete(void* p) noexcept { m2h::detail::countedFree(p); }
+void operator delete[](void* p) noexcept { m2h::detail::countedFree(p); }
+void operator delete(void* p, std::size_t) noexcept {
+  m2h::detail::countedFree(p);
+}
+void operator delete[](void* p, std::size_t) noexcept {
+  m2h::detail::countedFree(p);
+}
+#endif
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <cstddef>
+#include <cstring>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "../ParsingUtility.hpp"
+#include "../Trace.hpp"
 #include "../TypeAlias.hpp"
+#include "../limits/Limits.hpp"
 #include "Token.hpp"
 
 namespace m2h {
@@ -15,105 +20,167 @@ struct TokenizerContext {
 
 class Tokenizer {
  public:
-  explicit Tokenizer() : tokens{}, context{} {}
+  explicit Tokenizer() : tokens{}, context{}, limits{} {}
 
+  // Token count, consumed input, deadline and cancellation are checked
+  // while tokenizing; a breach throws LimitExceeded.
+  explicit Tokenizer(const Limits& limits)
+      : tokens{}, context{}, limits{limits} {}
+
+  // Drops the tokens of the last tokenize() but keeps their storage, so
+  // one Tokenizer can take many small inputs in turn.
+  void clear() {
+    tokens.clear();
+    context = TokenizerContext{};
+  }
+
+  // Input up to the first NUL.
   CRef<std::vector<Token>> tokenize(const char* p) {
-    while (*p != '\0') {
-      if (isSpace(*p)) {
-        // Indent
-        bool ok = tokenizeIndent(p);
-        if (!ok) {
-          p = context.savepoint;
-          goto fallback;
-        }
-        continue;
-      }
+    return tokenize(p, std::strlen(p));
+  }
 
-      if (isCrlf(*p)) {
-        // NewLine
-        tokenizeNewLine(p);
-        continue;
-      }
+  // [p, p + size) must not contain NUL and p[size] must be NUL, as in a
+  // std::string checked by Utf8Sink or sanitizeUtf8: the lookahead of the
+  // token rules stops at NUL, the main loop at `size`.
+  M2H_STAGE CRef<std::vector<Token>> tokenize(const char* p,
+                                              std::size_t size) {
+    M2H_TRACE0(tokenize_start);
+    const char* start = p;
+    const char* end = p + size;
+    while (p < end) {
+      tokenizeNext(p);
+      limits.checkTokens(tokens.size(), p - start);
+      limits.poll(p - start);
+    }
+    limits.checkNow(p - start);
+    tokens.emplace_back(TokenKind::Eof, "", p);
+    M2H_TRACE2(tokenize_end, p - start, tokens.size());
+    return tokens;
+  }
 
-      if (*p == '`') {
-        // BackQuotes
-        context.savepoint = p;
-        bool ok = tokenizeBackQuote(p);
-        if (!ok) {
-          p = context.savepoint;
-          goto fallback;
-        }
-        continue;
+  // Streaming variant: hands the tokens to `sink` in batches of roughly
+  // `batchSize` instead of keeping them all. The last batch ends with Eof.
+  template <class BatchSink>
+  M2H_STAGE void tokenize(const char* p, std::size_t size,
+                          std::size_t batchSize, BatchSink&& sink) {
+    M2H_TRACE0(tokenize_start);
+    const char* start = p;
+    const char* end = p + size;
+    std::size_t total = 0;
+    while (p < end) {
+      tokenizeNext(p);
+      limits.checkTokens(total + tokens.size(), p - start);
+      limits.poll(p - start);
+      if (tokens.size() >= batchSize) {
+        total += tokens.size();
+        M2H_TRACE2(token_batch, p - start, tokens.size());
+        sink(std::move(tokens));
+        tokens = std::vector<Token>{};
+        tokens.reserve(batchSize);
       }
+    }
+    limits.checkNow(p - start);
+    tokens.emplace_back(TokenKind::Eof, "", p);
+    total += tokens.size();
+    M2H_TRACE2(token_batch, p - start, tokens.size());
+    M2H_TRACE2(tokenize_end, p - start, total);
+    sink(std::move(tokens));
+    tokens = std::vector<Token>{};
+  }
 
-      if (oneof(*p, "[]()")) {
-        // brackets
-        context.savepoint = p;
-        bool ok = tokenizeBracket(p);
-        if (!ok) {
-          p = context.savepoint;
-          goto fallback;
-        }
-        continue;
+ private:
+  void tokenizeNext(const char*& p) {
+    if (isSpace(*p)) {
+      // Indent
+      bool ok = tokenizeIndent(p);
+      if (!ok) {
+        p = context.savepoint;
+        goto fallback;
       }
+      return;
+    }
 
-      if (isDigit(*p)) {
-        // OrderedListItems
-        context.savepoint = p;
-        bool ok = tokenizeOrderedList(p);
-        if (!ok) {
-          p = context.savepoint;
-          goto fallback;
-        }
-        continue;
+    if (isCrlf(*p)) {
+      // NewLine
+      tokenizeNewLine(p);
+      return;
+    }
+
+    if (*p == '`') {
+      // BackQuotes
+      context.savepoint = p;
+      bool ok = tokenizeBackQuote(p);
+      if (!ok) {
+        p = context.savepoint;
+        goto fallback;
       }
+      return;
+    }
 
-      if (oneof(*p, "+-*_")) {
-        // Horizontal
-        context.savepoint = p;
-        bool ok = tokenizeHorizontal(p);
-        if (ok) continue;
+    if (oneof(*p, "[]()")) {
+      // brackets
+      context.savepoint = p;
+      bool ok = tokenizeBracket(p);
+      if (!ok) {
         p = context.savepoint;
+        goto fallback;
+      }
+      return;
+    }
 
-        // UnorderedListItems
-        ok = tokenizeUnorderedList(p);
-        if (!ok) {
-          p = context.savepoint;
-          goto fallback;
-        }
-        continue;
+    if (isDigit(*p)) {
+      // OrderedListItems
+      context.savepoint = p;
+      bool ok = tokenizeOrderedList(p);
+      if (!ok) {
+        p = context.savepoint;
+        goto fallback;
       }
+      return;
+    }
 
-      if (*p == '>') {
-        // BlockQuote
-        context.savepoint = p;
-        bool ok = tokenizeBlockQuote(p);
-        if (!ok) {
-          p = context.savepoint;
-          goto fallback;
-        }
-        continue;
+    if (oneof(*p, "+-*_")) {
+      // Horizontal
+      context.savepoint = p;
+      bool ok = tokenizeHorizontal(p);
+      if (ok) return;
+      p = context.savepoint;
+
+      // UnorderedListItems
+      ok = tokenizeUnorderedList(p);
+      if (!ok) {
+        p = context.savepoint;
+        goto fallback;
       }
+      return;
+    }
 
-      if (*p == '#') {
-        // Heading
-        context.savepoint = p;
-        bool ok = tokenizeHeading(p);
-        if (!ok) {
-          p = context.savepoint;
-          goto fallback;
-        }
-        continue;
+    if (*p == '>') {
+      // BlockQuote
+      context.savepoint = p;
+      bool ok = tokenizeBlockQuote(p);
+      if (!ok) {
+        p = context.savepoint;
+        goto fallback;
       }
+      return;
+    }
 
-    fallback:
-      tokenizeText(p);
+    if (*p == '#') {
+      // Heading
+      context.savepoint = p;
+      bool ok = tokenizeHeading(p);
+      if (!ok) {
+        p = context.savepoint;
+        goto fallback;
+      }
+      return;
     }
-    tokens.emplace_back(TokenKind::Eof, "", p);
-    return tokens;
+
+  fallback:
+    tokenizeText(p);
   }
 
- private:
   bool tokenizeIndent(const char*& p) {
     int count = 0;
     const char* loc = p;
@@ -187,15 +254,15 @@ class Tokenizer {
 
   bool tokenizeText(const char*& p) {
     const char* p1 = p;
-    while (!isCrlf(*p)) {
-      while (!oneof(*p, "!*`[]()_") && !isCrlf(*p)) ++p;
+    while (!isCrlf(*p) && *p != '\0') {
+      while (!oneof(*p, "!*`[]()_") && !isCrlf(*p) && *p != '\0') ++p;
       auto text = std::string{p1, p};
       if (!text.empty()) {
         tokens.emplace_back(TokenKind::Text, text, p1);
         p1 = p;
         continue;
       }
-      if (isCrlf(*p)) return true;
+      if (isCrlf(*p) || *p == '\0') return true;
       if (oneof(*p, "*_")) {
         tokens.emplace_back(TokenKind::Emphasis, std::string{*p}, p1);
         p1 = ++p;
@@ -253,6 +320,7 @@ class Tokenizer {
  private:
   std::vector<Token> tokens;
   TokenizerContext context;
+  LimitChecker limits;
 };
 
 }  // namespace m2h
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Options.hpp"
+#include "document/Document.hpp"
+#include "io/BatchConverter.hpp"
+#include "io/IoUring.hpp"
+#include "limits/Limits.hpp"
+#include "output/CaptureStreamBuf.hpp"
+#include "output/LimitedStreamBuf.hpp"
+
+// Throws LimitExceeded when the document breaks one of `limits`, and
+// InvalidInput when it is not UTF-8 in Utf8Mode::Reject.
+std::string convertDocument(const std::string& s, const m2h::Limits& limits,
+                            m2h::Utf8Mode utf8) {
+  m2h::LimitChecker checker(limits);
+  const auto document = m2h::parseDocument(s, limits, nullptr, utf8);
+  m2h::CaptureStreamBuf html;
+  // drops what a block writes past the limit, so it is never held
+  m2h::LimitedStreamBuf limited(&html, limits.outputBytes);
+  std::ostream ost(&limited);
+  ost << styletag << std::endl;
+  for (auto&& node : document->blocks()) {
+    node->print(ost, "");
+    checker.checkOutput(limited.requested(), node->sourceEnd);
+    checker.poll(node->sourceEnd);
+  }
+  checker.checkNow(s.size());
+  return html.take();
+}
+
+int convertBatch(const Options& options) {
+  std::vector<m2h::BatchJob> jobs;
+  try {
+    jobs = m2h::collectJobs(options.input, options.batchOutput);
+  } catch (const std::exception& e) {
+    std::cerr << "failed to scan: '" << options.input << "': " << e.what()
+              << std::endl;
+    return 1;
+  }
+
+  const unsigned threads =
+      options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+  m2h::BatchStats stats;
+  std::unique_ptr<m2h::IoUring> ring;
+  if (options.io != "threads") {
+    ring.reset(new m2h::IoUring(256));
+    if (!*ring) {
+      if (options.io == "uring") {
+        std::cerr << "io_uring is not available" << std::endl;
+        return 1;
+      }
+      std::cout << "[info] io_uring is not available, using threads"
+                << std::endl;
+      ring.reset();
+    }
+  }
+  const m2h::ConvertFunction convert = [&](const std::string& s) {
+    return convertDocument(s, limitsFor(options), options.utf8);
+  };
+  std::cout << "[info] converting " << jobs.size() << " files" << std::endl;
+  if (ring) {
+    // one slot per file in flight, each needs at most two queue entries,
+    // and one entry for the wakeup from the converting threads
+    stats = m2h::UringBatch(*ring, jobs, convert, 127, threads).run();
+  } else {
+    stats = m2h::convertWithThreads(jobs, convert, threads);
+  }
+
+  const double seconds = std::max(stats.seconds, 1e-9);
+  std::cout << "[info] " << stats.backend << ": " << stats.files
+            << " files (" << stats.failed << " failed), " << stats.bytesIn
+            << " bytes in, " << stats.bytesOut << " bytes out, "
+            << stats.syscalls << " syscalls in " << stats.seconds << " s ("
+            << stats.files / seconds << " files/s, "
+            << stats.bytesIn / seconds / (1 << 20) << " MiB/s)" << std::endl;
+  return stats.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Options.hpp"
+#include "ast/BinaryAst.hpp"
+#include "document/Document.hpp"
+#include "io/MappedFile.hpp"
+
+// Counts and discards everything written to it.
+class DiscardStreamBuf : public std::streambuf {
+ public:
+  DiscardStreamBuf() : count{0} { setp(buffer, buffer + sizeof(buffer)); }
+
+  std::uint64_t written() const { return count + (pptr() - pbase()); }
+
+ protected:
+  int_type overflow(int_type c) override {
+    count += pptr() - pbase();
+    setp(buffer, buffer + sizeof(buffer));
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+ private:
+  char buffer[4096];
+  std::uint64_t count;
+};
+
+// Parses the input once and renders the shared document to html on 1, 2,
+// 4... up to `options.renderBench` threads at the same time, reporting
+// the renders per second at every thread count.
+int benchRender(const Options& options) {
+  std::ifstream ifs(options.input, std::ios::binary);
+  if (!ifs) {
+    std::cerr << "failed to open: '" << options.input << "'" << std::endl;
+    return 1;
+  }
+  std::ostringstream source;
+  source << ifs.rdbuf();
+  std::shared_ptr<const m2h::Document> document;
+  try {
+    document = m2h::parseDocument(source.str(), limitsFor(options), nullptr,
+                                  options.utf8);
+  } catch (const m2h::LimitExceeded& e) {
+    return rejected(options, e);
+  } catch (const m2h::InvalidInput& e) {
+    return rejected(options, e);
+  }
+  m2h::RenderOptions renderOptions;
+  renderOptions.sourcepos = options.sourcepos;
+
+  using clock = std::chrono::steady_clock;
+  const auto duration = std::chrono::milliseconds(500);
+  double single = 0;
+  for (unsigned threads = 1;; threads = std::min(threads * 2,
+                                                 options.renderBench)) {
+    std::vector<std::uint64_t> renders(threads), bytes(threads);
+    std::vector<std::thread> workers;
+    const auto start = clock::now();
+    const auto deadline = start + duration;
+    for (unsigned i = 0; i < threads; ++i) {
+      workers.emplace_back([&, i, document] {
+        DiscardStreamBuf discard;
+        std::ostream ost(&discard);
+        while (clock::now() < deadline) {
+          document->render(ost, renderOptions);
+          ++renders[i];
+        }
+        bytes[i] = discard.written();
+      });
+    }
+    for (auto&& worker : workers) worker.join();
+    const double seconds =
+        std::chrono::duration<double>(clock::now() - start).count();
+
+    std::uint64_t total = 0, totalBytes = 0;
+    for (unsigned i = 0; i < threads; ++i) {
+      total += renders[i];
+      totalBytes += bytes[i];
+    }
+    const double rate = total / seconds;
+    if (threads == 1) single = rate;
+    std::cout << "[info] " << threads << " threads: " << rate
+              << " renders/s (" << totalBytes / seconds / (1 << 20)
+              << " MiB/s), " << rate / std::max(single, 1e-9)
+              << "x of 1 thread" << std::endl;
+    if (threads == options.renderBench) break;
+  }
+  return 0;
+}
+
+// Runs `load` repeatedly for about half a second and returns its mean
+// time in milliseconds.
+template <class Load>
+double timeLoads(Load&& load) {
+  using clock = std::chrono::steady_clock;
+  const auto start = clock::now();
+  const auto deadline = start + std::chrono::milliseconds(500);
+  std::size_t loads = 0;
+  do {
+    load();
+    ++loads;
+  } while (clock::now() < deadline);
+  return std::chrono::duration<double, std::milli>(clock::now() - start)
+             .count() /
+         loads;
+}
+
+// Compares the two ways a tool can get at the tree of a document: reading
+// and parsing the markdown again, or mapping the binary ast written by
+// --ast and reading it in place. Both visit every node once.
+int benchAst(const Options& options) {
+  std::size_t parsedNodes = 0;
+  auto parse = [&] {
+    std::ifstream ifs(options.input, std::ios::binary);
+    std::ostringstream source;
+    source << ifs.rdbuf();
+    const auto document =
+        m2h::parseDocument(source.str(), m2h::Limits{}, nullptr, options.utf8);
+    std::vector<const m2h::Node*> pending(document->blocks().begin(),
+                                          document->blocks().end());
+    parsedNodes = 0;
+    while (!pending.empty()) {
+      const m2h::Node* node = pending.back();
+      pending.pop_back();
+      pending.insert(pending.end(), node->children().begin(),
+                     node->children().end());
+      ++parsedNodes;
+    }
+  };
+  std::size_t mappedNodes = 0;
+  auto map = [&] {
+    m2h::MappedFile file(options.astBench);
+    m2h::AstView view(file.data(), file.size());
+    if (!view.validate()) throw std::runtime_error("invalid binary ast");
+    std::vector<m2h::AstNodeView> pending;
+    for (std::uint32_t i = 0; i < view.rootCount(); ++i) {
+      pending.push_back(view.root(i));
+    }
+    mappedNodes = 0;
+    while (!pending.empty()) {
+      const m2h::AstNodeView node = pending.back();
+      pending.pop_back();
+      for (std::uint32_t i = 0; i < node.childCount(); ++i) {
+        pending.push_back(node.child(i));
+      }
+      ++mappedNodes;
+    }
+  };
+
+  {
+    std::ifstream ifs(options.input, std::ios::binary);
+    if (!ifs) {
+      std::cerr << "failed to open: '" << options.input << "'" << std::endl;
+      return 1;
+    }
+    std::ostringstream source;
+    source << ifs.rdbuf();
+    std::shared_ptr<const m2h::Document> document;
+    try {
+      document = m2h::parseDocument(source.str(), m2h::Limits{}, nullptr,
+                                    options.utf8);
+    } catch (const m2h::InvalidInput& e) {
+      return rejected(options, e);
+    }
+    std::ofstream astofs(options.astBench, std::ios::binary);
+    try {
+      m2h::writeAst(document->blocks(), astofs);
+    } catch (const m2h::LimitExceeded& e) {
+      return rejected(options, e);
+    }
+    if (!astofs.flush()) {
+      std::cerr << "failed to write: '" << options.astBench << "'"
+                << std::endl;
+      return 1;
+    }
+  }
+  const double parseMs = timeLoads(parse);
+  const double mapMs = timeLoads(map);
+  if (parsedNodes != mappedNodes) {
+    std::cerr << "[error] the binary ast has " << mappedNodes
+              << " nodes, the parsed document " << parsedNodes << std::endl;
+    return 1;
+  }
+  std::cout << "[info] " << parsedNodes << " nodes: parse " << parseMs
+            << " ms, mapped ast " << mapMs << " ms per load ("
+            << parseMs / std::max(mapMs, 1e-9) << "x)" << std::endl;
+  return 0;
+}
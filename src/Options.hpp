@@ -0,0 +1,203 @@
+#pragma once
+
+#include <zlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "io/Utf8.hpp"
+#include "limits/Limits.hpp"
+#include "stats/AllocationStats.hpp"
+
+// The command line of main.bin and what every mode shares: the limits of
+// a conversion and how a rejected document is reported.
+
+const std::string styletag =
+    "<link rel=\"stylesheet\" href=\"./resources/style.css\" />";
+
+const std::string outputPath = "./result.html";
+
+struct Options {
+  std::string input;
+  bool gzip = false;
+  int gzipLevel = Z_DEFAULT_COMPRESSION;
+  std::string indexJson;
+  std::string indexBinary;
+  std::string ast;
+  bool pipeline = false;
+  std::string batchOutput;
+  std::string io = "auto";
+  unsigned jobs = 0;
+  std::string watchOutput;
+  int debounceMs = 20;
+  std::string text;
+  std::string summary;
+  bool allocationStats = false;
+  std::vector<m2h::AllocationBudget> allocationBudgets;
+  m2h::Limits limits;
+  long timeoutMs = 0;
+  bool etag = false;
+  bool etagSha256 = false;
+  bool sourcepos = false;
+  std::string section;
+  std::string patch;
+  unsigned renderBench = 0;
+  std::string astBench;
+  m2h::Utf8Mode utf8 = m2h::Utf8Mode::Reject;
+};
+
+// Set by SIGINT/SIGTERM while a single document is converted.
+std::atomic<bool> cancelled{false};
+
+extern "C" void cancelConversion(int) { cancelled = true; }
+
+// The limits of one conversion starting now.
+m2h::Limits limitsFor(const Options& options) {
+  m2h::Limits limits = options.limits;
+  if (options.timeoutMs > 0) {
+    limits.deadline = m2h::Limits::Clock::now() +
+                      std::chrono::milliseconds(options.timeoutMs);
+  }
+  limits.cancel = &cancelled;
+  return limits;
+}
+
+void usage() {
+  std::cerr << "usage: ./md2html [--gzip[=level]] [--index=out.json]"
+               " [--index-bin=out.bin] [--ast=out.ast] [--pipeline]"
+               " [--text=out.txt] [--summary=out.txt] [--etag[=sha256]]"
+               " [--sourcepos] [--section=anchor|N] [--patch=out.json]"
+               " [--alloc-stats]"
+               " [--alloc-budget=stage:allocs-per-KiB:peak-bytes-per-KiB]..."
+               " [limits] /path/to/markdown.md"
+            << std::endl;
+  std::cerr << "       ./md2html --batch=/path/to/outdir"
+               " [--io=auto|uring|threads] [--jobs=N] /path/to/indir"
+            << std::endl;
+  std::cerr << "       ./md2html --render-bench=threads [--sourcepos] [limits]"
+               " /path/to/markdown.md"
+            << std::endl;
+  std::cerr << "       ./md2html --ast-bench=out.ast /path/to/markdown.md"
+            << std::endl;
+  std::cerr << "       ./md2html --watch=/path/to/outdir [--debounce=ms]"
+               " [limits] /path/to/indir"
+            << std::endl;
+  std::cerr << "limits: [--max-input=bytes] [--max-tokens=N] [--max-nodes=N]"
+               " [--max-depth=N] [--max-output=bytes] [--timeout=ms]"
+               " [--utf8=reject|repair]"
+            << std::endl;
+}
+
+bool parseOptions(int argc, char const* argv[], Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--gzip") {
+      options.gzip = true;
+    } else if (arg.compare(0, 7, "--gzip=") == 0) {
+      options.gzip = true;
+      options.gzipLevel = std::atoi(arg.c_str() + 7);
+      if (options.gzipLevel < 0 || options.gzipLevel > 9) return false;
+    } else if (arg.compare(0, 8, "--index=") == 0) {
+      options.indexJson = arg.substr(8);
+    } else if (arg.compare(0, 12, "--index-bin=") == 0) {
+      options.indexBinary = arg.substr(12);
+    } else if (arg.compare(0, 6, "--ast=") == 0) {
+      options.ast = arg.substr(6);
+    } else if (arg == "--pipeline") {
+      options.pipeline = true;
+    } else if (arg.compare(0, 7, "--text=") == 0) {
+      options.text = arg.substr(7);
+    } else if (arg.compare(0, 10, "--summary=") == 0) {
+      options.summary = arg.substr(10);
+    } else if (arg == "--sourcepos") {
+      options.sourcepos = true;
+    } else if (arg.compare(0, 10, "--section=") == 0) {
+      options.section = arg.substr(10);
+      if (options.section.empty()) return false;
+    } else if (arg.compare(0, 8, "--patch=") == 0) {
+      options.patch = arg.substr(8);
+    } else if (arg == "--etag") {
+      options.etag = true;
+    } else if (arg == "--etag=sha256") {
+      options.etag = true;
+      options.etagSha256 = true;
+    } else if (arg == "--alloc-stats") {
+      options.allocationStats = true;
+    } else if (arg.compare(0, 15, "--alloc-budget=") == 0) {
+      // stage:allocations-per-KiB:peak-bytes-per-KiB
+      const std::string spec = arg.substr(15);
+      const auto c1 = spec.find(':');
+      const auto c2 = spec.find(':', c1 == std::string::npos ? c1 : c1 + 1);
+      if (c1 == std::string::npos || c2 == std::string::npos) return false;
+      options.allocationBudgets.push_back(
+          {spec.substr(0, c1), std::atof(spec.c_str() + c1 + 1),
+           std::atof(spec.c_str() + c2 + 1)});
+      options.allocationStats = true;
+    } else if (arg.compare(0, 8, "--batch=") == 0) {
+      options.batchOutput = arg.substr(8);
+    } else if (arg.compare(0, 8, "--watch=") == 0) {
+      options.watchOutput = arg.substr(8);
+    } else if (arg.compare(0, 11, "--debounce=") == 0) {
+      options.debounceMs = std::atoi(arg.c_str() + 11);
+      if (options.debounceMs < 0) return false;
+    } else if (arg.compare(0, 5, "--io=") == 0) {
+      options.io = arg.substr(5);
+      if (options.io != "auto" && options.io != "uring" &&
+          options.io != "threads") {
+        return false;
+      }
+    } else if (arg.compare(0, 12, "--max-input=") == 0) {
+      options.limits.inputBytes = std::strtoull(arg.c_str() + 12, nullptr, 10);
+    } else if (arg.compare(0, 13, "--max-tokens=") == 0) {
+      options.limits.tokens = std::strtoull(arg.c_str() + 13, nullptr, 10);
+    } else if (arg.compare(0, 12, "--max-nodes=") == 0) {
+      options.limits.nodes = std::strtoull(arg.c_str() + 12, nullptr, 10);
+    } else if (arg.compare(0, 12, "--max-depth=") == 0) {
+      options.limits.depth = std::strtoull(arg.c_str() + 12, nullptr, 10);
+    } else if (arg.compare(0, 13, "--max-output=") == 0) {
+      options.limits.outputBytes = std::strtoull(arg.c_str() + 13, nullptr, 10);
+    } else if (arg.compare(0, 10, "--timeout=") == 0) {
+      options.timeoutMs = std::atol(arg.c_str() + 10);
+      if (options.timeoutMs <= 0) return false;
+    } else if (arg.compare(0, 7, "--utf8=") == 0) {
+      if (arg == "--utf8=repair") {
+        options.utf8 = m2h::Utf8Mode::Repair;
+      } else if (arg == "--utf8=reject") {
+        options.utf8 = m2h::Utf8Mode::Reject;
+      } else {
+        return false;
+      }
+    } else if (arg.compare(0, 12, "--ast-bench=") == 0) {
+      options.astBench = arg.substr(12);
+      if (options.astBench.empty()) return false;
+    } else if (arg.compare(0, 15, "--render-bench=") == 0) {
+      options.renderBench = static_cast<unsigned>(std::atoi(arg.c_str() + 15));
+      if (options.renderBench == 0) return false;
+    } else if (arg.compare(0, 7, "--jobs=") == 0) {
+      options.jobs = static_cast<unsigned>(std::atoi(arg.c_str() + 7));
+    } else if (arg[0] == '-' || !options.input.empty()) {
+      return false;
+    } else {
+      options.input = arg;
+    }
+  }
+  // a section is converted by itself, there is nothing to overlap
+  if (options.pipeline && !options.section.empty()) return false;
+  return !options.input.empty();
+}
+
+// For LimitExceeded and InvalidInput.
+int rejected(const Options& options, const std::exception& e) {
+  std::cerr << "failed to convert: '" << options.input << "': " << e.what();
+  // rejecting became the default, so say how to get the old behaviour
+  if (dynamic_cast<const m2h::InvalidInput*>(&e)) {
+    std::cerr << " (--utf8=repair replaces it)";
+  }
+  std::cerr << std::endl;
+  return 3;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BatchMode.hpp"
+#include "Options.hpp"
+#include "hash/Xxh64.hpp"
+#include "io/BatchConverter.hpp"
+#include "io/DirectoryWatcher.hpp"
+
+// State kept between rebuilds in watch mode: the content hash of every
+// converted input and a reusable read buffer.
+struct WatchState {
+  std::unordered_map<std::string, std::uint64_t> hashes;
+  std::string source;
+};
+
+enum class Rebuild { Converted, Unchanged, Failed, Rejected };
+
+// Converts `input` unless its content hash matches the last conversion.
+// Documents breaking the limits are reported here and left unconverted.
+Rebuild rebuild(WatchState& state, const Options& options,
+                const std::string& input, const std::string& output) {
+  std::ifstream ifs(input, std::ios::binary);
+  if (!ifs) return Rebuild::Failed;
+  state.source.clear();
+  char buf[65536];
+  while (ifs.read(buf, sizeof(buf)) || ifs.gcount() > 0) {
+    state.source.append(buf, ifs.gcount());
+  }
+
+  const std::uint64_t hash =
+      m2h::Xxh64::hash(state.source.data(), state.source.size());
+  auto found = state.hashes.find(input);
+  if (found != state.hashes.end() && found->second == hash) {
+    return Rebuild::Unchanged;
+  }
+
+  std::string html;
+  try {
+    html = convertDocument(state.source, limitsFor(options), options.utf8);
+  } catch (const m2h::LimitExceeded& e) {
+    std::cerr << "failed to convert: '" << input << "': " << e.what()
+              << std::endl;
+    return Rebuild::Rejected;
+  } catch (const m2h::InvalidInput& e) {
+    std::cerr << "failed to convert: '" << input << "': " << e.what()
+              << std::endl;
+    return Rebuild::Rejected;
+  }
+  std::error_code ec;
+  std::filesystem::create_directories(
+      std::filesystem::path(output).parent_path(), ec);
+  std::ofstream ofs(output, std::ios::binary);
+  ofs << html;
+  if (!ofs) return Rebuild::Failed;
+  state.hashes[input] = hash;
+  return Rebuild::Converted;
+}
+
+int watchDirectory(const Options& options) {
+  using clock = std::chrono::steady_clock;
+  const std::string& inputDir = options.input;
+  const std::string& outputDir = options.watchOutput;
+
+  m2h::DirectoryWatcher watcher(inputDir);
+  if (!watcher) {
+    std::cerr << "failed to watch: '" << inputDir << "'" << std::endl;
+    return 1;
+  }
+
+  WatchState state;
+  auto start = clock::now();
+  std::vector<m2h::BatchJob> jobs;
+  try {
+    jobs = m2h::collectJobs(inputDir, outputDir);
+  } catch (const std::exception& e) {
+    std::cerr << "failed to scan: '" << inputDir << "': " << e.what()
+              << std::endl;
+    return 1;
+  }
+  for (auto&& job : jobs) {
+    if (rebuild(state, options, job.input, job.output) == Rebuild::Failed) {
+      std::cerr << "failed to convert: '" << job.input << "'" << std::endl;
+    }
+  }
+  std::cout << "[info] converted " << jobs.size() << " files in "
+            << std::chrono::duration<double, std::milli>(clock::now() - start)
+                   .count()
+            << " ms, watching '" << inputDir << "'" << std::endl;
+
+  while (true) {
+    auto changes = watcher.wait(std::chrono::milliseconds(options.debounceMs));
+    start = clock::now();
+    std::size_t converted = 0, unchanged = 0;
+    for (auto&& change : changes) {
+      const std::string& input = change.first;
+      if (std::filesystem::path(input).extension() != ".md") continue;
+      const std::string output =
+          m2h::outputPathFor(input, inputDir, outputDir);
+      if (change.second == m2h::DirectoryWatcher::Change::Removed) {
+        state.hashes.erase(input);
+        std::error_code ec;
+        std::filesystem::remove(output, ec);
+        std::cout << "[info] removed " << output << std::endl;
+        continue;
+      }
+      switch (rebuild(state, options, input, output)) {
+        case Rebuild::Converted:
+          ++converted;
+          std::cout << "[info] rebuilt " << output << std::endl;
+          break;
+        case Rebuild::Unchanged:
+          ++unchanged;
+          break;
+        case Rebuild::Failed:
+          std::cerr << "failed to convert: '" << input << "'" << std::endl;
+          break;
+        case Rebuild::Rejected:
+          break;
+      }
+    }
+    if (converted + unchanged > 0) {
+      std::cout << "[info] " << converted << " rebuilt, " << unchanged
+                << " unchanged in "
+                << std::chrono::duration<double, std::milli>(clock::now() -
+                                                             start)
+                       .count()
+                << " ms" << std::endl;
+    }
+  }
+}
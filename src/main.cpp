@@ -1,44 +1,424 @@
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "Trace.hpp"
+#include "ast/BinaryAst.hpp"
+#include "diff/BlockDiff.hpp"
+#include "io/MappedFile.hpp"
+#include "io/Utf8.hpp"
+#include "limits/Limits.hpp"
+#include "output/CaptureStreamBuf.hpp"
+#include "output/GzipStreamBuf.hpp"
+#include "output/HashingStreamBuf.hpp"
+#include "output/LimitedStreamBuf.hpp"
+#include "output/TeeStreamBuf.hpp"
+#include "parser/DocumentIndex.hpp"
 #include "parser/Parser.hpp"
+#include "parser/SectionIndex.hpp"
+#include "pipeline/Pipeline.hpp"
+#include "render/HtmlRenderer.hpp"
+#include "render/MultiRenderer.hpp"
+#include "render/PlainTextRenderer.hpp"
+#include "render/SummaryRenderer.hpp"
+#include "stats/AllocationStats.hpp"
 #include "tokenizer/Tokenizer.hpp"
 
-const std::string styletag =
-    "<link rel=\"stylesheet\" href=\"./resources/style.css\" />";
+#include "BatchMode.hpp"
+#include "BenchMode.hpp"
+#include "Options.hpp"
+#include "WatchMode.hpp"
 
-int main(int argc, char const* argv[]) {
-  if (argc != 2) {
-    std::cerr << "usage: ./md2html /path/to/markdown.md" << std::endl;
+// Prints the allocations of every stage and returns false if one of them
+// exceeds its budget.
+bool reportAllocations(const Options& options,
+                       const m2h::AllocationProfile& profile,
+                       std::size_t inputBytes) {
+  const double kib = std::max(1.0, inputBytes / 1024.0);
+  bool ok = true;
+  for (auto&& stage : profile.stages) {
+    const double allocations = stage.allocations / kib;
+    const double peak = stage.peakBytes / kib;
+    std::cout << "[info] allocations " << stage.stage << ": "
+              << stage.allocations << " (" << allocations << "/KiB), "
+              << stage.bytes << " bytes, peak " << stage.peakBytes
+              << " bytes (" << peak << "/KiB)" << std::endl;
+    for (auto&& budget : options.allocationBudgets) {
+      if (budget.stage != stage.stage) continue;
+      if (allocations > budget.allocationsPerKiB ||
+          peak > budget.peakBytesPerKiB) {
+        std::cerr << "[error] allocation budget exceeded in " << stage.stage
+                  << ": " << allocations << " allocations/KiB (budget "
+                  << budget.allocationsPerKiB << "), " << peak
+                  << " peak bytes/KiB (budget " << budget.peakBytesPerKiB
+                  << ")" << std::endl;
+        ok = false;
+      }
+    }
+  }
+  for (auto&& budget : options.allocationBudgets) {
+    auto measured = std::find_if(
+        profile.stages.begin(), profile.stages.end(),
+        [&](const m2h::StageAllocations& s) { return s.stage == budget.stage; });
+    if (measured == profile.stages.end()) {
+      std::cerr << "[error] no stage '" << budget.stage
+                << "' was measured for its allocation budget" << std::endl;
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+// The markdown to convert: the whole input, or the section of it given by
+// --section and where that starts in the file.
+struct Input {
+  std::string text;
+  std::uint64_t replaced = 0;  // bytes replaced with U+FFFD
+  std::size_t offset = 0;
+  std::size_t line = 1;
+  std::size_t column = 1;
+  bool part = false;  // a section ending before the file does
+};
+
+// Copies only the section out of the mapping, so the limits apply to its
+// size. Returns the exit status of a failure, or 0.
+int readSection(const Options& options, m2h::AllocationProfile& profile,
+                Input& input) {
+  profile.begin("read");
+  m2h::MappedFile file(options.input);
+  if (!file) {
+    std::cerr << "failed to open: '" << options.input << "'" << std::endl;
+    return 1;
+  }
+  const m2h::SectionIndex sections(file.data(), file.size());
+  const m2h::SectionEntry* section = sections.find(options.section);
+  if (!section) {
+    std::cerr << "failed to find section: '" << options.section << "' in '"
+              << options.input << "'" << std::endl;
     return 1;
   }
+  input.text.reserve(section->end - section->begin);
+  m2h::Utf8Sink sink(input.text, options.utf8, section->begin);
+  try {
+    sink.append(file.data() + section->begin, section->end - section->begin);
+    sink.finish();
+  } catch (const m2h::InvalidInput& e) {
+    return rejected(options, e);
+  }
+  input.replaced = sink.replaced();
+  input.offset = section->begin;
+  input.line = section->line;
+  input.column = section->column;
+  input.part = section->end != file.size();
+  profile.end();
+  std::cout << "[info] section '" << section->anchor << "': bytes "
+            << section->begin << "-" << section->end << " of "
+            << file.size() << std::endl;
+  return 0;
+}
 
-  std::ifstream ifs(argv[1]);
+// Reads the whole input. Returns the exit status of a failure, or 0.
+int readFile(const Options& options, const m2h::Limits& limits,
+             m2h::AllocationProfile& profile, Input& input) {
+  std::ifstream ifs(options.input, std::ios::binary);
   if (!ifs) {
-    std::cerr << "failed to open: '" << argv[1] << "'" << std::endl;
+    std::cerr << "failed to open: '" << options.input << "'" << std::endl;
+    return 1;
+  }
+  std::error_code ec;
+  const auto inputSize = std::filesystem::file_size(options.input, ec);
+  if (!ec && inputSize > limits.inputBytes) {
+    return rejected(options, m2h::LimitExceeded(m2h::LimitKind::InputBytes,
+                                                limits.inputBytes, 0));
+  }
+
+  profile.begin("read");
+  if (!ec) input.text.reserve(inputSize);
+  m2h::Utf8Sink sink(input.text, options.utf8);
+  // chunks small enough to still be in cache when they are checked
+  char buf[65536];
+  try {
+    while (ifs.read(buf, sizeof(buf)) || ifs.gcount() > 0) {
+      sink.append(buf, ifs.gcount());
+    }
+    sink.finish();
+  } catch (const m2h::InvalidInput& e) {
+    return rejected(options, e);
+  }
+  input.replaced = sink.replaced();
+  profile.end();
+  return 0;
+}
+
+// Writes the patch against the state of the last run, then the state of
+// this one. Returns the exit status of a failure, or 0.
+int writePatch(const Options& options, m2h::BlockDiff& blockDiff) {
+  // the block hashes of this run are kept next to the patch
+  const std::string statePath = options.patch + ".state";
+  std::ifstream stateifs(statePath, std::ios::binary);
+  if (!blockDiff.readState(stateifs)) {
+    std::cout << "[info] no usable patch state (" << statePath
+              << "), the patch replaces every block" << std::endl;
+  }
+  // the state moves on only once the patch against it is written
+  std::ofstream patchofs(options.patch);
+  const std::size_t ops = blockDiff.writePatch(patchofs);
+  patchofs.close();
+  if (!patchofs) {
+    std::cerr << "failed to write: '" << options.patch << "'" << std::endl;
+    return 1;
+  }
+  std::ofstream stateofs(statePath, std::ios::binary);
+  blockDiff.writeState(stateofs);
+  stateofs.close();
+  if (!stateofs) {
+    // without it the next patch starts over with a reset
+    std::remove(statePath.c_str());
+    std::cerr << "failed to write: '" << statePath << "'" << std::endl;
     return 1;
   }
+  std::cout << "[info] writing patch (" << options.patch << "): " << ops
+            << " ops from " << blockDiff.previousBlocks() << " to "
+            << blockDiff.blocks() << " blocks" << std::endl;
+  return 0;
+}
 
-  std::string s;
-  char buf[1024];
-  while (!ifs.eof()) {
-    ifs.read(buf, 1024);
-    s.append(buf, ifs.gcount());
+// Converts the single document of `options.input` to result.html and the
+// other outputs asked for.
+int convertFile(const Options& options) {
+  if (options.allocationStats && !m2h::allocationStatsEnabled) {
+    std::cerr << "allocation stats need a build with "
+                 "-DMD2HTML_ALLOCATION_STATS=ON"
+              << std::endl;
+    return 1;
   }
+  m2h::AllocationProfile profile;
 
-  std::cout << "[info] start tokenizing" << std::endl;
-  m2h::Tokenizer tokenizer;
-  std::vector<m2h::Token> tokens = tokenizer.tokenize(s.c_str());
+  std::signal(SIGINT, cancelConversion);
+  std::signal(SIGTERM, cancelConversion);
+  const m2h::Limits limits = limitsFor(options);
+  m2h::LimitChecker checker(limits);
 
-  std::cout << "[info] start parsing" << std::endl;
-  m2h::Parser parser;
-  std::vector<m2h::Node*> nodes = parser.parse(tokens);
+  // the input, checked for UTF-8 while it is read so that the tokenizer
+  // gets valid text of known length
+  Input input;
+  if (const int status = options.section.empty()
+                             ? readFile(options, limits, profile, input)
+                             : readSection(options, profile, input)) {
+    return status;
+  }
+  if (input.replaced != 0) {
+    std::cerr << "[warning] replaced " << input.replaced
+              << " invalid UTF-8 sequences or NUL bytes with U+FFFD"
+              << std::endl;
+  }
+  M2H_TRACE1(document_start, input.text.size());
 
-  std::cout << "[info] generating html (./result.html)" << std::endl;
-  std::ofstream ofs("./result.html");
-  ofs << styletag << std::endl;
-  for (auto&& node : nodes) {
-    node->print(ofs, "");
+  std::ofstream ofs(outputPath);
+  std::ofstream gzofs;
+  std::unique_ptr<m2h::GzipStreamBuf> gzbuf;
+  std::unique_ptr<m2h::TeeStreamBuf> tee;
+  std::ostream ost(ofs.rdbuf());
+  if (options.gzip) {
+    // compress on the fly while writing the plain html
+    gzofs.open(outputPath + ".gz", std::ios::binary);
+    gzbuf.reset(new m2h::GzipStreamBuf(gzofs, options.gzipLevel));
+    tee.reset(new m2h::TeeStreamBuf(ofs.rdbuf(), gzbuf.get()));
+    ost.rdbuf(tee.get());
+  }
+  std::unique_ptr<m2h::HashingStreamBuf> hashing;
+  if (options.etag) {
+    hashing.reset(new m2h::HashingStreamBuf(ost.rdbuf(), options.etagSha256));
+    ost.rdbuf(hashing.get());
+  }
+  std::unique_ptr<m2h::LimitedStreamBuf> limited;
+  if (limits.outputBytes != m2h::Limits{}.outputBytes) {
+    limited.reset(new m2h::LimitedStreamBuf(ost.rdbuf(), limits.outputBytes));
+    ost.rdbuf(limited.get());
+  }
+  // the html of every top-level block, for the patch against the last run
+  m2h::BlockDiff blockDiff(options.sourcepos);
+  std::unique_ptr<m2h::CaptureStreamBuf> capture;
+  if (!options.patch.empty()) {
+    capture.reset(new m2h::CaptureStreamBuf(ost.rdbuf()));
+    ost.rdbuf(capture.get());
+  }
+  // every output is produced by the same traversal of the document
+  m2h::MultiRenderer renderers;
+  m2h::LineIndex lines(input.text.data(), input.text.size(), input.line, input.column);
+  m2h::RendererFor<m2h::HtmlRenderer> html(
+      ost, options.sourcepos ? &lines : nullptr);
+  renderers.attach(&html);
+  // with positions, blocks are compared by their html without them
+  const bool positionFree = capture && options.sourcepos;
+  m2h::CaptureStreamBuf content;
+  std::ostream contentost(&content);
+  m2h::RendererFor<m2h::HtmlRenderer> contentHtml(contentost, nullptr);
+  if (positionFree) renderers.attach(&contentHtml);
+  std::ofstream textofs;
+  std::unique_ptr<m2h::Renderer> text;
+  if (!options.text.empty()) {
+    textofs.open(options.text);
+    text.reset(new m2h::RendererFor<m2h::PlainTextRenderer>(textofs));
+    renderers.attach(text.get());
+  }
+  std::ofstream summaryofs;
+  std::unique_ptr<m2h::Renderer> summary;
+  if (!options.summary.empty()) {
+    summaryofs.open(options.summary);
+    summary.reset(new m2h::RendererFor<m2h::SummaryRenderer>(summaryofs));
+    renderers.attach(summary.get());
+  }
+
+  // called after every top-level block
+  auto endBlock = [&](const m2h::Node* node) {
+    if (positionFree) {
+      blockDiff.addBlock(capture->take(), content.take(),
+                         lines.position(node->sourceBegin).line);
+    } else if (capture) {
+      blockDiff.addBlock(capture->take());
+    }
+    if (limited) checker.checkOutput(limited->requested(), node->sourceEnd);
+    checker.poll(node->sourceEnd);
+  };
+
+  m2h::DocumentIndex index;
+  std::vector<const m2h::Node*> nodes;
+  try {
+    checker.checkInput(input.text.size());
+    if (options.pipeline) {
+      std::cout << "[info] tokenizing, parsing and generating html ("
+                << outputPath << ") in parallel" << std::endl;
+      profile.begin("pipeline");
+      ost << styletag << std::endl;
+      if (capture) capture->take();
+      m2h::runPipeline(
+          input.text.c_str(), input.text.size(), &index,
+          [&](m2h::Node* node) {
+            nodes.push_back(node);
+            m2h::emitEvents(node, renderers);
+            endBlock(node);
+          },
+          m2h::PipelineOptions{}, limits);
+      checker.checkNow(input.text.size());
+      renderers.finish();
+      ost.flush();
+      profile.end();
+    } else {
+      std::cout << "[info] start tokenizing" << std::endl;
+      profile.begin("tokenize");
+      m2h::Tokenizer tokenizer(limits);
+      std::vector<m2h::Token> tokens = tokenizer.tokenize(input.text.c_str(), input.text.size());
+      profile.end();
+
+      std::cout << "[info] start parsing" << std::endl;
+      profile.begin("parse");
+      m2h::Parser parser(&index, limits);
+      const std::vector<m2h::Node*> parsed =
+          input.part ? parser.parsePart(tokens) : parser.parse(tokens);
+      nodes.assign(parsed.begin(), parsed.end());
+      profile.end();
+
+      std::cout << "[info] generating html (" << outputPath << ")" << std::endl;
+      profile.begin("render");
+      M2H_TRACE1(render_start, nodes.size());
+      ost << styletag << std::endl;
+      if (capture) capture->take();
+      for (auto&& node : nodes) {
+        m2h::emitEvents(node, renderers);
+        endBlock(node);
+      }
+      checker.checkNow(input.text.size());
+      renderers.finish();
+      ost.flush();
+      M2H_TRACE1(render_end, nodes.size());
+      profile.end();
+    }
+  } catch (const m2h::LimitExceeded& e) {
+    return rejected(options, e);
+  }
+  M2H_TRACE2(document_end, input.text.size(), nodes.size());
+  index.rebase(input.offset);
+  if (hashing) {
+    const m2h::OutputDigest digest = hashing->digest();
+    std::cout << "[info] html: " << digest.bytes << " bytes, etag "
+              << digest.etag() << std::endl;
+  }
+  if (gzbuf) {
+    std::cout << "[info] compressed html (" << outputPath << ".gz)"
+              << std::endl;
+    if (!gzbuf->finish()) ost.setstate(std::ios::badbit);
+  }
+  if (!ost || !ofs || (gzbuf && !gzofs)) {
+    std::cerr << "failed to write: '" << outputPath << "'" << std::endl;
+    return 1;
+  }
+  if (text && !textofs) {
+    std::cerr << "failed to write: '" << options.text << "'" << std::endl;
+    return 1;
+  }
+  if (summary && !summaryofs) {
+    std::cerr << "failed to write: '" << options.summary << "'" << std::endl;
+    return 1;
+  }
+
+  if (!options.indexJson.empty()) {
+    std::cout << "[info] writing index (" << options.indexJson << ")"
+              << std::endl;
+    std::ofstream indexofs(options.indexJson);
+    index.writeJson(indexofs);
+  }
+  if (!options.indexBinary.empty()) {
+    std::cout << "[info] writing index (" << options.indexBinary << ")"
+              << std::endl;
+    std::ofstream indexofs(options.indexBinary, std::ios::binary);
+    index.writeBinary(indexofs);
+  }
+  if (capture) {
+    if (const int status = writePatch(options, blockDiff)) return status;
+  }
+  if (!options.ast.empty()) {
+    std::cout << "[info] writing ast (" << options.ast << ")" << std::endl;
+    std::ofstream astofs(options.ast, std::ios::binary);
+    try {
+      m2h::writeAst(nodes, astofs);
+    } catch (const m2h::LimitExceeded& e) {
+      return rejected(options, e);
+    }
+  }
+
+  if (options.allocationStats &&
+      !reportAllocations(options, profile, input.text.size())) {
+    return 2;
+  }
+  return 0;
+}
+
+int main(int argc, char const* argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    usage();
+    return 1;
+  }
+
+  if (!options.batchOutput.empty()) {
+    return convertBatch(options);
+  }
+  if (!options.watchOutput.empty()) {
+    return watchDirectory(options);
+  }
+  if (options.renderBench != 0) {
+    return benchRender(options);
+  }
+  if (!options.astBench.empty()) {
+    return benchAst(options);
   }
+  return convertFile(options);
 }
@@ -0,0 +1,144 @@
+// Converts the files in resources/ and a few generated documents under
+// the counting allocator and fails when a stage allocates more, per KiB of
+// input, than its budget below. The budgets leave about twice the room
+// the stages need today; tighten them when a stage gets leaner.
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "parser/EventParser.hpp"
+#include "parser/Parser.hpp"
+#include "render/HtmlRenderer.hpp"
+#include "stats/AllocationStats.hpp"
+#include "tokenizer/Tokenizer.hpp"
+
+namespace {
+
+// allocations and peak live bytes per KiB of input
+const std::vector<m2h::AllocationBudget> budgets = {
+    {"tokenize", 120, 100000},
+    {"parse", 1400, 60000},
+    {"render", 80, 600},
+};
+
+// Swallows the html, so that only the renderer's own allocations count.
+class NullStreamBuf : public std::streambuf {
+ protected:
+  std::streamsize xsputn(const char*, std::streamsize n) override {
+    return n;
+  }
+  int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+};
+
+using Documents = std::vector<std::pair<std::string, std::string>>;
+
+Documents generatedDocuments(const Documents& resources) {
+  Documents documents;
+  std::string all;
+  for (int i = 0; i < 40; ++i) {
+    for (auto&& resource : resources) all += resource.second + "\n";
+  }
+  std::string nested;
+  for (int depth = 0; depth < 200; ++depth) {
+    nested += std::string(depth, '>') + " quote " + std::to_string(depth) +
+              "\n" + std::string(2 * depth, ' ') + "- item\n";
+  }
+  std::string inlines;
+  for (int i = 0; i < 2000; ++i) {
+    inlines += "text *em* **strong** `code` [link](http://example.com/" +
+               std::to_string(i) + ") ![alt](img.png)\n";
+  }
+  std::string code;
+  for (int i = 0; i < 1000; ++i) {
+    code += "# Heading " + std::to_string(i) + "\n```\nint x = " +
+            std::to_string(i) + ";\n```\n\n1. one\n2. two\n\n---\n";
+  }
+  documents.emplace_back("generated/all", all);
+  documents.emplace_back("generated/nested", nested);
+  documents.emplace_back("generated/inlines", inlines);
+  documents.emplace_back("generated/code", code);
+  return documents;
+}
+
+// Returns false if a stage of converting `source` exceeds its budget.
+bool checkDocument(const std::string& name, const std::string& source) {
+  m2h::AllocationProfile profile;
+  {
+    profile.begin("tokenize");
+    m2h::Tokenizer tokenizer;
+    std::vector<m2h::Token> tokens =
+        tokenizer.tokenize(source.c_str(), source.size());
+    profile.end();
+
+    profile.begin("parse");
+    m2h::Parser parser;
+    std::vector<m2h::Node*> nodes = parser.parse(tokens);
+    profile.end();
+
+    profile.begin("render");
+    NullStreamBuf null;
+    std::ostream ost(&null);
+    m2h::HtmlRenderer html(ost);
+    for (auto&& node : nodes) m2h::emitEvents(node, html);
+    profile.end();
+
+    for (auto&& node : nodes) m2h::destroyTree(node);
+  }
+
+  const double kib = std::max(1.0, source.size() / 1024.0);
+  bool ok = true;
+  for (auto&& stage : profile.stages) {
+    const double allocations = stage.allocations / kib;
+    const double peak = stage.peakBytes / kib;
+    std::cout << name << " " << stage.stage << ": " << allocations
+              << " allocations/KiB, " << peak << " peak bytes/KiB"
+              << std::endl;
+    for (auto&& budget : budgets) {
+      if (budget.stage != stage.stage) continue;
+      if (allocations > budget.allocationsPerKiB ||
+          peak > budget.peakBytesPerKiB) {
+        std::cerr << "[error] " << name << ": allocation budget exceeded in "
+                  << stage.stage << " (budget " << budget.allocationsPerKiB
+                  << " allocations/KiB, " << budget.peakBytesPerKiB
+                  << " peak bytes/KiB)" << std::endl;
+        ok = false;
+      }
+    }
+  }
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::cerr << "usage: allocation_budget_test /path/to/resources"
+              << std::endl;
+    return 1;
+  }
+  Documents documents;
+  for (auto&& entry : std::filesystem::directory_iterator(argv[1])) {
+    if (entry.path().extension() != ".md") continue;
+    std::ifstream ifs(entry.path(), std::ios::binary);
+    documents.emplace_back(entry.path().filename().string(),
+                           std::string{std::istreambuf_iterator<char>(ifs),
+                                       std::istreambuf_iterator<char>()});
+  }
+  std::sort(documents.begin(), documents.end());
+  const Documents generated = generatedDocuments(documents);
+
+  bool ok = true;
+  for (auto&& document : documents) {
+    ok = checkDocument(document.first, document.second) && ok;
+  }
+  for (auto&& document : generated) {
+    ok = checkDocument(document.first, document.second) && ok;
+  }
+  return ok ? 0 : 1;
+}
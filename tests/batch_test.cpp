@@ -0,0 +1,131 @@
+// Converts resources/ with `main.bin --batch` on the blocking backend and
+// on io_uring with one and with several converting threads; every output
+// must be the same. UringBatch is also run directly on a ring far smaller
+// than the number of files in flight, with and without workers, against
+// the conversion done in place. Exits 77 (skipped) where io_uring is not
+// available, after checking the blocking backend.
+#include <unistd.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "document/Document.hpp"
+#include "io/BatchConverter.hpp"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+std::string readFile(const fs::path& path) {
+  std::ifstream ifs(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(ifs),
+          std::istreambuf_iterator<char>()};
+}
+
+bool runBatch(const std::string& mainBin, const std::string& resources,
+              const fs::path& output, const std::string& io,
+              unsigned jobs) {
+  const std::string command = "'" + mainBin + "' --batch='" +
+                              output.string() + "' --io=" + io +
+                              " --jobs=" + std::to_string(jobs) + " '" +
+                              resources + "' > /dev/null";
+  if (std::system(command.c_str()) != 0) {
+    std::cerr << "[error] failed: " << command << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Whether every file below `expected` is in `found` with the same bytes.
+bool sameOutput(const fs::path& expected, const fs::path& found,
+                const std::string& name) {
+  bool ok = true;
+  std::size_t files = 0;
+  for (auto&& entry : fs::recursive_directory_iterator(expected)) {
+    if (!entry.is_regular_file()) continue;
+    ++files;
+    const fs::path other = found / fs::relative(entry.path(), expected);
+    if (readFile(entry.path()) != readFile(other)) {
+      std::cerr << "[error] " << name << ": " << other.string()
+                << " differs from " << entry.path().string() << std::endl;
+      ok = false;
+    }
+  }
+  if (files == 0) {
+    std::cerr << "[error] " << name << ": no output" << std::endl;
+    return false;
+  }
+  return ok;
+}
+
+std::string convert(const std::string& source) {
+  std::ostringstream ost;
+  m2h::parseDocument(source)->render(ost, m2h::RenderOptions{});
+  return ost.str();
+}
+
+bool checkSmallRing(const std::string& resources, const fs::path& output,
+                    unsigned threads) {
+  const std::vector<m2h::BatchJob> jobs =
+      m2h::collectJobs(resources, output.string());
+  m2h::IoUring ring(4);
+  const m2h::ConvertFunction function = convert;
+  const m2h::BatchStats stats =
+      m2h::UringBatch(ring, jobs, function, 16, threads).run();
+  bool ok = stats.failed == 0 && stats.files == jobs.size();
+  for (auto&& job : jobs) {
+    if (readFile(job.output) != convert(readFile(job.input))) {
+      std::cerr << "[error] small ring with " << threads << " threads: "
+                << job.output << " differs" << std::endl;
+      ok = false;
+    }
+  }
+  if (stats.failed != 0) {
+    std::cerr << "[error] small ring with " << threads << " threads: "
+              << stats.failed << " files failed" << std::endl;
+  }
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 3) {
+    std::cerr << "usage: batch_test /path/to/main.bin /path/to/resources"
+              << std::endl;
+    return 1;
+  }
+  const std::string mainBin = argv[1];
+  const std::string resources = argv[2];
+  const fs::path root = fs::temp_directory_path() /
+                        ("m2h_batch_test_" + std::to_string(::getpid()));
+  fs::remove_all(root);
+
+  bool ok = runBatch(mainBin, resources, root / "threads", "threads", 2);
+  const bool uring = static_cast<bool>(m2h::IoUring(4));
+  if (uring) {
+    for (unsigned jobs : {1u, 4u}) {
+      const std::string name = "uring-" + std::to_string(jobs);
+      ok = runBatch(mainBin, resources, root / name, "uring", jobs) &&
+           sameOutput(root / "threads", root / name, name) && ok;
+    }
+    for (unsigned threads : {0u, 3u}) {
+      ok = checkSmallRing(resources,
+                          root / ("small-" + std::to_string(threads)),
+                          threads) &&
+           ok;
+    }
+  } else {
+    std::cout << "[info] io_uring is not available, only the blocking "
+              << "backend was checked" << std::endl;
+  }
+  fs::remove_all(root);
+  if (!ok) return 1;
+  return uring ? 0 : 77;
+}
@@ -0,0 +1,171 @@
+// Writes the tree of every file in resources/ as a binary ast, reads it
+// back through AstView into a tree of its own and compares the printed
+// html of both. Truncated and corrupted copies must be refused, and so
+// must counts that do not fit the u32 fields.
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ast/BinaryAst.hpp"
+#include "document/Document.hpp"
+
+namespace {
+
+// A Node tree built from what AstView reads, through the public
+// constructors only, so it can be printed like the parsed one.
+m2h::Node* build(const m2h::AstNodeView& view) {
+  const std::string text{view.text()};
+  const std::string url{view.url()};
+  m2h::Node* node = nullptr;
+  std::uint32_t i = 0;
+  switch (view.type()) {
+    case m2h::NodeType::Paragraph:
+      if (view.childCount() == 0) return nullptr;
+      node = new m2h::ParagraphNode(view.value(), build(view.child(i++)));
+      break;
+    case m2h::NodeType::BlockQuote:
+      node = new m2h::BlockQuoteNode();
+      break;
+    case m2h::NodeType::UnorderedList:
+      node = new m2h::UnorderedListNode(view.value());
+      break;
+    case m2h::NodeType::UnorderedListItem:
+      node = new m2h::UnorderedListItemNode();
+      break;
+    case m2h::NodeType::OrderedList:
+      node = new m2h::OrderedListNode(view.value());
+      break;
+    case m2h::NodeType::OrderedListItem:
+      node = new m2h::OrderedListItemNode();
+      break;
+    case m2h::NodeType::EmptyLine:
+      node = new m2h::EmptyLineNode();
+      break;
+    case m2h::NodeType::Horizontal:
+      node = new m2h::HorizontalNode();
+      break;
+    case m2h::NodeType::Heading:
+      node = new m2h::HeadingNode(view.value(), text);
+      break;
+    case m2h::NodeType::InlineCode:
+      node = new m2h::InlineCodeNode(text);
+      break;
+    case m2h::NodeType::CodeBlock:
+      node = new m2h::CodeBlockNode(text);
+      break;
+    case m2h::NodeType::Text:
+      node = new m2h::TextNode(text);
+      break;
+    case m2h::NodeType::Emphasis:
+      node = new m2h::EmphasisNode(view.value(), text);
+      break;
+    case m2h::NodeType::Link:
+      node = new m2h::LinkNode(url, text);
+      break;
+    case m2h::NodeType::Image:
+      node = new m2h::ImageNode(url, text);
+      break;
+    default:
+      return nullptr;
+  }
+  for (; i < view.childCount(); ++i) {
+    if (m2h::Node* child = build(view.child(i))) node->addChild(child);
+  }
+  return node;
+}
+
+std::string print(const m2h::Node* node) {
+  std::ostringstream ost;
+  if (node) node->print(ost, "");
+  return ost.str();
+}
+
+// True if AstView refuses `bytes`, in the constructor or in validate().
+bool refused(const std::string& bytes) {
+  try {
+    return !m2h::AstView(bytes.data(), bytes.size()).validate();
+  } catch (const std::runtime_error&) {
+    return true;
+  }
+}
+
+bool checkDocument(const std::string& name, const std::string& source) {
+  const auto document = m2h::parseDocument(source);
+  std::ostringstream ost;
+  m2h::writeAst(document->blocks(), ost);
+  const std::string bytes = ost.str();
+
+  const m2h::AstView view(bytes.data(), bytes.size());
+  bool ok = view.validate() &&
+            view.rootCount() == document->blocks().size();
+  for (std::uint32_t i = 0; ok && i < view.rootCount(); ++i) {
+    const m2h::Node* read = build(view.root(i));
+    ok = print(read) == print(document->blocks()[i]);
+    if (read) m2h::destroyTree(read);
+  }
+  if (!ok) {
+    std::cerr << "[error] " << name << ": the binary ast differs from the "
+              << "parsed tree" << std::endl;
+    return false;
+  }
+
+  std::string badMagic = bytes;
+  badMagic[0] = 'X';
+  std::string badVersion = bytes;
+  ++badVersion[4];
+  if (!refused(bytes.substr(0, bytes.size() / 2)) || !refused(badMagic) ||
+      !refused(badVersion)) {
+    std::cerr << "[error] " << name << ": a corrupted binary ast was "
+              << "accepted" << std::endl;
+    return false;
+  }
+  if (view.nodeCount() > 1) {
+    // a child range pointing outside the records
+    std::string badChild = bytes;
+    auto records = reinterpret_cast<m2h::AstNodeRecord*>(
+        &badChild[sizeof(m2h::AstHeader)]);
+    records[0].firstChild = view.nodeCount();
+    records[0].childCount = 1;
+    if (!refused(badChild)) {
+      std::cerr << "[error] " << name << ": a child range outside the "
+                << "records was accepted" << std::endl;
+      return false;
+    }
+  }
+  std::cout << name << ": " << view.nodeCount() << " nodes" << std::endl;
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::cerr << "usage: binary_ast_test /path/to/resources" << std::endl;
+    return 1;
+  }
+  std::vector<std::filesystem::path> paths;
+  for (auto&& entry : std::filesystem::directory_iterator(argv[1])) {
+    if (entry.path().extension() == ".md") paths.push_back(entry.path());
+  }
+  std::sort(paths.begin(), paths.end());
+  bool ok = true;
+  try {
+    m2h::astField(std::uint64_t{1} << 32, m2h::LimitKind::Nodes, 0);
+    std::cerr << "[error] a count over 32 bits was accepted" << std::endl;
+    ok = false;
+  } catch (const m2h::LimitExceeded&) {
+  }
+  for (auto&& path : paths) {
+    std::ifstream ifs(path, std::ios::binary);
+    const std::string source{std::istreambuf_iterator<char>(ifs),
+                             std::istreambuf_iterator<char>()};
+    ok = checkDocument(path.filename().string(), source) && ok;
+  }
+  return ok ? 0 : 1;
+}
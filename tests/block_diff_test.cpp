@@ -0,0 +1,146 @@
+// Renders every file in resources/ block by block as main.bin does with
+// --sourcepos --patch, then an edited copy with a line inserted near the
+// top. The patch between them must carry the html of the blocks around
+// the new line only and move the others with a single "lines" operation.
+// Without a usable state, or with one rendered without positions, the
+// patch must reset and insert every block.
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "diff/BlockDiff.hpp"
+#include "document/Document.hpp"
+#include "output/CaptureStreamBuf.hpp"
+#include "parser/EventParser.hpp"
+#include "render/HtmlRenderer.hpp"
+#include "render/MultiRenderer.hpp"
+
+namespace {
+
+void addBlocks(m2h::BlockDiff& diff, const std::string& source) {
+  const auto document = m2h::parseDocument(source);
+  m2h::CaptureStreamBuf html, content;
+  std::ostream htmlost(&html), contentost(&content);
+  m2h::RendererFor<m2h::HtmlRenderer> withPositions(htmlost,
+                                                    &document->lines());
+  m2h::RendererFor<m2h::HtmlRenderer> withoutPositions(contentost, nullptr);
+  m2h::MultiRenderer renderers;
+  renderers.attach(&withPositions);
+  renderers.attach(&withoutPositions);
+  for (auto&& node : document->blocks()) {
+    m2h::emitEvents(node, renderers);
+    diff.addBlock(html.take(), content.take(),
+                  document->lines().position(node->sourceBegin).line);
+  }
+}
+
+std::size_t count(const std::string& s, const std::string& what) {
+  std::size_t n = 0;
+  for (auto at = s.find(what); at != std::string::npos;
+       at = s.find(what, at + 1)) {
+    ++n;
+  }
+  return n;
+}
+
+bool checkDocument(const std::string& name, const std::string& source) {
+  // after the first line, which is never inside a fence in resources/
+  const std::size_t eol = source.find('\n');
+  if (eol == std::string::npos) return true;
+  std::string edited = source;
+  edited.insert(eol + 1, "\ninserted\n");
+
+  m2h::BlockDiff before(true);
+  addBlocks(before, source);
+  std::stringstream state;
+  before.writeState(state);
+
+  m2h::BlockDiff after(true);
+  if (!after.readState(state)) {
+    std::cerr << "[error] " << name << ": state not read back" << std::endl;
+    return false;
+  }
+  addBlocks(after, edited);
+  std::ostringstream patch;
+  const std::size_t ops = after.writePatch(patch);
+  const std::string json = patch.str();
+
+  // the inserted line may join the block above, all the blocks after
+  // it are the same two lines further down
+  const bool ok = ops <= 4 && count(json, "\"op\":\"remove\"") == 0 &&
+                  count(json, "\"op\":\"lines\"") <= 1 &&
+                  count(json, "\"op\":\"lines\"") ==
+                      count(json, "\"delta\":2");
+  if (!ok) {
+    std::cerr << "[error] " << name << ": unexpected patch for one "
+              << "inserted line: " << json.substr(0, 400) << std::endl;
+  }
+
+  // the same render again is an empty patch
+  std::stringstream again;
+  after.writeState(again);
+  m2h::BlockDiff same(true);
+  same.readState(again);
+  addBlocks(same, edited);
+  std::ostringstream empty;
+  same.writePatch(empty);
+  if (empty.str().find("\"ops\":[]") == std::string::npos) {
+    std::cerr << "[error] " << name << ": patch between equal renders: "
+              << empty.str().substr(0, 400) << std::endl;
+    return false;
+  }
+
+  // missing, truncated and other-mode states all start over
+  std::string full = again.str();
+  std::stringstream withoutPositions;
+  m2h::BlockDiff other;
+  other.addBlock("<p>x</p>\n");
+  other.writeState(withoutPositions);
+  const std::string states[] = {"", full.substr(0, full.size() - 1),
+                                "M2HD" + full.substr(8),
+                                withoutPositions.str()};
+  for (auto&& bad : states) {
+    std::stringstream stateist(bad);
+    m2h::BlockDiff reset(true);
+    if (reset.readState(stateist)) {
+      std::cerr << "[error] " << name << ": bad state accepted" << std::endl;
+      return false;
+    }
+    addBlocks(reset, edited);
+    std::ostringstream resetPatch;
+    const std::size_t resetOps = reset.writePatch(resetPatch);
+    const std::string resetJson = resetPatch.str();
+    if (resetJson.find("\"ops\":[{\"op\":\"reset\"}") ==
+            std::string::npos ||
+        resetOps != reset.blocks() + 1 ||
+        count(resetJson, "\"op\":\"insert\"") != reset.blocks()) {
+      std::cerr << "[error] " << name << ": patch without a state: "
+                << resetJson.substr(0, 400) << std::endl;
+      return false;
+    }
+  }
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::cerr << "usage: block_diff_test /path/to/resources" << std::endl;
+    return 1;
+  }
+  namespace fs = std::filesystem;
+  bool ok = true;
+  for (auto&& entry : fs::directory_iterator(argv[1])) {
+    const fs::path& path = entry.path();
+    if (path.extension() != ".md") continue;
+    std::ifstream ifs(path, std::ios::binary);
+    const std::string source{std::istreambuf_iterator<char>(ifs),
+                             std::istreambuf_iterator<char>()};
+    ok = checkDocument(path.filename().string(), source) && ok;
+  }
+  return ok ? 0 : 1;
+}
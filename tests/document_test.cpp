@@ -0,0 +1,95 @@
+// One Document per file in resources/, rendered by several threads at
+// once in every format: each render must equal the one made before the
+// threads started.
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "document/Document.hpp"
+
+namespace {
+
+std::vector<m2h::RenderOptions> allOptions() {
+  std::vector<m2h::RenderOptions> all;
+  for (auto format : {m2h::OutputFormat::Html, m2h::OutputFormat::Text,
+                      m2h::OutputFormat::Summary}) {
+    for (bool sourcepos : {false, true}) {
+      m2h::RenderOptions options;
+      options.format = format;
+      options.sourcepos = sourcepos;
+      all.push_back(options);
+    }
+  }
+  return all;
+}
+
+std::string render(const m2h::Document& document,
+                   const m2h::RenderOptions& options) {
+  std::ostringstream ost;
+  document.render(ost, options);
+  return ost.str();
+}
+
+bool checkDocument(const std::string& name, const std::string& source) {
+  const std::vector<m2h::RenderOptions> options = allOptions();
+  // the reference comes from a document of its own, so the threads
+  // below also race to build the line index of the shared one
+  std::vector<std::string> expected;
+  {
+    const auto document = m2h::parseDocument(source);
+    for (auto&& o : options) expected.push_back(render(*document, o));
+  }
+
+  const auto document = m2h::parseDocument(source);
+  const unsigned threads = 4;
+  const unsigned rounds = 20;
+  std::vector<unsigned> mismatches(threads, 0);
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      for (unsigned r = 0; r < rounds; ++r) {
+        // each thread starts with another format
+        for (std::size_t i = 0; i < options.size(); ++i) {
+          const std::size_t k = (i + t) % options.size();
+          if (render(*document, options[k]) != expected[k]) ++mismatches[t];
+        }
+      }
+    });
+  }
+  for (auto&& worker : workers) worker.join();
+
+  unsigned total = 0;
+  for (unsigned m : mismatches) total += m;
+  if (total != 0) {
+    std::cerr << "[error] " << name << ": " << total << " of "
+              << threads * rounds * options.size()
+              << " concurrent renders differ" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::cerr << "usage: document_test /path/to/resources" << std::endl;
+    return 1;
+  }
+  namespace fs = std::filesystem;
+  bool ok = true;
+  for (auto&& entry : fs::directory_iterator(argv[1])) {
+    const fs::path& path = entry.path();
+    if (path.extension() != ".md") continue;
+    std::ifstream ifs(path, std::ios::binary);
+    const std::string source{std::istreambuf_iterator<char>(ifs),
+                             std::istreambuf_iterator<char>()};
+    ok = checkDocument(path.filename().string(), source) && ok;
+  }
+  return ok ? 0 : 1;
+}
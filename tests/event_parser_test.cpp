@@ -0,0 +1,113 @@
+// parseEvents with HtmlRenderer must write the same bytes as parsing the
+// whole tree and printing it with Node::print, for the files in
+// resources/ and for nesting deeper than maxIndentDepth. A handler that
+// declares only some callbacks must see every block exactly once.
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "parser/EventParser.hpp"
+#include "parser/Parser.hpp"
+#include "render/HtmlRenderer.hpp"
+#include "tokenizer/Tokenizer.hpp"
+
+namespace {
+
+std::string printTree(const std::string& source) {
+  m2h::Tokenizer tokenizer;
+  std::vector<m2h::Token> tokens =
+      tokenizer.tokenize(source.c_str(), source.size());
+  std::ostringstream ost;
+  for (auto&& node : m2h::Parser().parse(tokens)) {
+    node->print(ost, "");
+    m2h::destroyTree(node);
+  }
+  return ost.str();
+}
+
+std::string renderEvents(const std::string& source) {
+  m2h::Tokenizer tokenizer;
+  std::vector<m2h::Token> tokens =
+      tokenizer.tokenize(source.c_str(), source.size());
+  std::ostringstream ost;
+  m2h::HtmlRenderer renderer(ost);
+  m2h::parseEvents(tokens, renderer);
+  return ost.str();
+}
+
+// Counts enter and exit events only; everything else is EventHandler's.
+struct BlockCounter : m2h::EventHandler {
+  void enterBlock(m2h::NodeType, int) { ++entered; }
+  void exitBlock(m2h::NodeType, int) { ++exited; }
+  std::size_t entered = 0;
+  std::size_t exited = 0;
+};
+
+bool checkDocument(const std::string& name, const std::string& source) {
+  const std::string expected = printTree(source);
+  const std::string found = renderEvents(source);
+  if (found != expected) {
+    std::size_t at = 0;
+    while (at < found.size() && at < expected.size() &&
+           found[at] == expected[at]) {
+      ++at;
+    }
+    std::cerr << "[error] " << name << ": parseEvents differs from "
+              << "Node::print at byte " << at << ": '"
+              << found.substr(at, 40) << "' instead of '"
+              << expected.substr(at, 40) << "'" << std::endl;
+    return false;
+  }
+
+  m2h::Tokenizer tokenizer;
+  std::vector<m2h::Token> tokens =
+      tokenizer.tokenize(source.c_str(), source.size());
+  BlockCounter counter;
+  m2h::parseEvents(tokens, counter);
+  if (counter.entered != counter.exited) {
+    std::cerr << "[error] " << name << ": " << counter.entered
+              << " blocks entered, " << counter.exited << " exited"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::cerr << "usage: event_parser_test /path/to/resources" << std::endl;
+    return 1;
+  }
+  namespace fs = std::filesystem;
+  std::vector<std::pair<std::string, std::string>> documents;
+  for (auto&& entry : fs::directory_iterator(argv[1])) {
+    const fs::path& path = entry.path();
+    if (path.extension() != ".md") continue;
+    std::ifstream ifs(path, std::ios::binary);
+    documents.emplace_back(path.filename().string(),
+                           std::string{std::istreambuf_iterator<char>(ifs),
+                                       std::istreambuf_iterator<char>()});
+  }
+  const std::size_t depth = 2 * m2h::maxIndentDepth;
+  documents.emplace_back("deep quotes",
+                         std::string(depth, '>') + " text\n\n# after\n");
+  std::string list;
+  for (std::size_t i = 0; i < depth; ++i) {
+    list += std::string(2 * i, ' ') + "- item " + std::to_string(i) + "\n";
+  }
+  documents.emplace_back("deep list", list);
+
+  bool ok = true;
+  for (auto&& document : documents) {
+    ok = checkDocument(document.first, document.second) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+// A deadline that has passed must stop every stage, also when the input
+// is a single line that makes a single step, and a failing pipeline stage
+// must stop the others early and be the error that is reported.
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "limits/Limits.hpp"
+#include "parser/DocumentIndex.hpp"
+#include "parser/Parser.hpp"
+#include "pipeline/Pipeline.hpp"
+#include "tokenizer/Tokenizer.hpp"
+
+namespace {
+
+m2h::Limits expired() {
+  m2h::Limits limits;
+  limits.deadline = m2h::Limits::Clock::now() - std::chrono::seconds(1);
+  return limits;
+}
+
+// Whether `run` throws LimitExceeded of the given kind.
+bool throwsLimit(m2h::LimitKind kind, const std::function<void()>& run) {
+  try {
+    run();
+  } catch (const m2h::LimitExceeded& e) {
+    return e.kind() == kind;
+  }
+  return false;
+}
+
+bool checkDeadline() {
+  std::string line;
+  for (int i = 0; i < 200000; ++i) line += "word ";
+  const std::string small = "# heading\n\nparagraph\n";
+  bool ok = true;
+
+  if (!throwsLimit(m2h::LimitKind::Deadline, [&] {
+        m2h::Tokenizer(expired()).tokenize(line.c_str(), line.size());
+      })) {
+    std::cerr << "[error] deadline: not noticed while tokenizing a single "
+                 "line" << std::endl;
+    ok = false;
+  }
+  if (!throwsLimit(m2h::LimitKind::Deadline, [&] {
+        auto tokens =
+            m2h::Tokenizer().tokenize(small.c_str(), small.size());
+        for (auto&& node : m2h::Parser(nullptr, expired()).parse(tokens)) {
+          m2h::destroyTree(node);
+        }
+      })) {
+    std::cerr << "[error] deadline: not noticed while parsing a small "
+                 "document" << std::endl;
+    ok = false;
+  }
+  if (!throwsLimit(m2h::LimitKind::Deadline, [&] {
+        m2h::runPipeline(line.c_str(), line.size(), nullptr,
+                         [](m2h::Node* node) { m2h::destroyTree(node); },
+                         m2h::PipelineOptions{}, expired());
+      })) {
+    std::cerr << "[error] deadline: not noticed by the pipeline"
+              << std::endl;
+    ok = false;
+  }
+  return ok;
+}
+
+bool checkPipelineStop() {
+  const std::size_t headings = 200000;
+  std::string source;
+  for (std::size_t i = 0; i < headings; ++i) source += "# heading\n\n";
+
+  m2h::DocumentIndex index;
+  std::size_t emitted = 0;
+  std::string error;
+  try {
+    m2h::runPipeline(source.c_str(), source.size(), &index,
+                     [&](m2h::Node* node) {
+                       m2h::destroyTree(node);
+                       ++emitted;
+                       throw std::runtime_error("emit failed");
+                     });
+  } catch (const std::exception& e) {
+    error = e.what();
+  }
+  if (error != "emit failed" || emitted != 1) {
+    std::cerr << "[error] pipeline: expected the emit error once, got '"
+              << error << "' after " << emitted << " nodes" << std::endl;
+    return false;
+  }
+  if (index.headings.size() == headings) {
+    std::cerr << "[error] pipeline: the parser went on to the end after "
+                 "emit failed" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  bool ok = checkDeadline();
+  ok = checkPipelineStop() && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+// LineIndex must end lines where Tokenizer does, at "\n", "\r\n" and a
+// lone '\r', also where a "\r\n" straddles the 16-byte chunks of the
+// vectorized scan. Checked against a byte-by-byte count on random inputs,
+// and through --sourcepos html, which must not depend on the line ends.
+#include <cstddef>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "document/Document.hpp"
+#include "parser/LineIndex.hpp"
+
+namespace {
+
+// Line and column of every offset, one byte at a time.
+std::vector<m2h::SourcePosition> positions(const std::string& s) {
+  std::vector<m2h::SourcePosition> all;
+  std::size_t line = 1, column = 1;
+  for (std::size_t i = 0; i <= s.size(); ++i) {
+    all.push_back({line, column});
+    if (i == s.size()) break;
+    const bool end =
+        s[i] == '\n' || (s[i] == '\r' && (i + 1 == s.size() || s[i + 1] != '\n'));
+    if (end) {
+      ++line;
+      column = 1;
+    } else {
+      ++column;
+    }
+  }
+  return all;
+}
+
+bool checkInput(const std::string& s) {
+  const m2h::LineIndex lines(s.data(), s.size());
+  const std::vector<m2h::SourcePosition> expected = positions(s);
+  for (std::size_t i = 0; i <= s.size(); ++i) {
+    const m2h::SourcePosition found = lines.position(i);
+    if (found.line != expected[i].line || found.column != expected[i].column) {
+      std::cerr << "[error] offset " << i << " of " << m2h::escapeJson(s)
+                << ": " << found.line << ":" << found.column << " instead of "
+                << expected[i].line << ":" << expected[i].column << std::endl;
+      return false;
+    }
+    // newlines() up to every line start counts the lines before it
+    if (expected[i].column == 1 &&
+        m2h::LineIndex::newlines(s.data(), i) + 1 != expected[i].line) {
+      std::cerr << "[error] newlines up to " << i << " of "
+                << m2h::escapeJson(s) << std::endl;
+      return false;
+    }
+  }
+  if (lines.lines() != expected.back().line) {
+    std::cerr << "[error] " << lines.lines() << " lines in "
+              << m2h::escapeJson(s) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// the data-sourcepos attributes of the html of `source`
+std::string sourcepos(const std::string& source) {
+  std::ostringstream ost;
+  m2h::RenderOptions options;
+  options.sourcepos = true;
+  m2h::parseDocument(source)->render(ost, options);
+  const std::string html = ost.str();
+  const std::regex attribute("data-sourcepos=\"[0-9:-]*\"");
+  std::string found;
+  for (std::sregex_iterator it(html.begin(), html.end(), attribute), end;
+       it != end; ++it) {
+    found += it->str() + "\n";
+  }
+  return found;
+}
+
+}  // namespace
+
+int main() {
+  bool ok = true;
+  std::mt19937 random(20261019);
+  const char bytes[] = {'a', 'a', '\n', '\r'};
+  for (int n = 0; n < 20000 && ok; ++n) {
+    std::string s(random() % 70, 'a');
+    for (auto&& c : s) c = bytes[random() % 4];
+    ok = checkInput(s);
+  }
+  // "\r\n" across the first chunk boundary, and a '\r' ending a chunk
+  ok = checkInput(std::string(15, 'a') + "\r\n" + std::string(20, 'a')) && ok;
+  ok = checkInput(std::string(15, 'a') + "\ra" + std::string(20, 'a')) && ok;
+  ok = checkInput(std::string(16, 'a') + "\r") && ok;
+
+  const std::string lf = "# Title\n\ntext\nmore\n\n> quote\n\n- item\n";
+  for (const char* end : {"\r", "\r\n"}) {
+    const std::string other = std::regex_replace(lf, std::regex("\n"), end);
+    if (sourcepos(other) != sourcepos(lf)) {
+      std::cerr << "[error] --sourcepos differs with " << m2h::escapeJson(end)
+                << " line ends:\n"
+                << sourcepos(other) << "instead of\n"
+                << sourcepos(lf);
+      ok = false;
+    }
+  }
+  return ok ? 0 : 1;
+}
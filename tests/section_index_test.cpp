@@ -0,0 +1,170 @@
+// SectionIndex must find the same top-level headings, with the same
+// anchors, as parsing the whole document with Parser and DocumentIndex.
+// Checked on the files in resources/, on known hard cases and on random
+// documents put together from markdown fragments.
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "parser/DocumentIndex.hpp"
+#include "parser/Parser.hpp"
+#include "parser/SectionIndex.hpp"
+#include "tokenizer/Tokenizer.hpp"
+
+namespace {
+
+// The top-level headings of the whole document and where their
+// sections end.
+std::vector<m2h::SectionEntry> parsedSections(const std::string& source) {
+  m2h::Tokenizer tokenizer;
+  std::vector<m2h::Token> tokens =
+      tokenizer.tokenize(source.c_str(), source.size());
+  m2h::DocumentIndex index;
+  std::vector<std::size_t> top;
+  for (auto&& node : m2h::Parser(&index).parse(tokens)) {
+    if (node->type == m2h::NodeType::Heading) top.push_back(node->sourceBegin);
+    m2h::destroyTree(node);
+  }
+  const m2h::LineIndex lines(source.data(), source.size());
+  std::vector<m2h::SectionEntry> sections;
+  for (auto&& heading : index.headings) {
+    if (std::find(top.begin(), top.end(), heading.offset) == top.end()) {
+      continue;
+    }
+    const m2h::SourcePosition position = lines.position(heading.offset);
+    sections.push_back({heading.level, heading.text, heading.anchor,
+                        heading.offset, source.size(), position.line,
+                        position.column});
+  }
+  for (std::size_t i = 0; i < sections.size(); ++i) {
+    for (std::size_t j = i + 1; j < sections.size(); ++j) {
+      if (sections[j].level <= sections[i].level) {
+        sections[i].end = sections[j].begin;
+        break;
+      }
+    }
+  }
+  return sections;
+}
+
+bool same(const m2h::SectionEntry& a, const m2h::SectionEntry& b) {
+  return a.level == b.level && a.text == b.text && a.anchor == b.anchor &&
+         a.begin == b.begin && a.end == b.end && a.line == b.line &&
+         a.column == b.column;
+}
+
+void print(const char* what, const std::vector<m2h::SectionEntry>& entries) {
+  std::cerr << "  " << what << ":";
+  for (auto&& e : entries) {
+    std::cerr << " [" << e.level << " '" << e.anchor << "' " << e.begin << "-"
+              << e.end << " " << e.line << ":" << e.column << "]";
+  }
+  std::cerr << std::endl;
+}
+
+// Returns whether the scan was used, through `scanned`.
+bool checkDocument(const std::string& name, const std::string& source,
+                   bool& scanned) {
+  const m2h::SectionIndex index(source.data(), source.size());
+  const std::vector<m2h::SectionEntry> expected = parsedSections(source);
+  const std::vector<m2h::SectionEntry>& found = index.sections();
+  scanned = index.scanned();
+  if (found.size() == expected.size() &&
+      std::equal(found.begin(), found.end(), expected.begin(), same)) {
+    return true;
+  }
+  std::cerr << "[error] " << name << ": sections differ from the parsed "
+            << "document (" << (scanned ? "scanned" : "parsed") << ")"
+            << std::endl;
+  print("expected", expected);
+  print("found", found);
+  return false;
+}
+
+const char* const fragments[] = {
+    "# ",    "## ",   "#",       "Foo",  "foo bar", "`",     "```", "\n",
+    "\n\n",  "> ",    "- ",      "* ",   "1. ",     "    ",  "  ",  "\t",
+    "x`y`z", "[a](b)", "*e*",    "\r\n", "---\n",   "```\n", "_",   "![i](u)",
+    "\r",    "```\r",
+};
+
+std::string randomDocument(std::mt19937& random) {
+  const std::size_t count = std::size(fragments);
+  std::string source;
+  const std::size_t pieces = 1 + random() % 40;
+  for (std::size_t i = 0; i < pieces; ++i) {
+    // headings at line starts more often than elsewhere
+    if (random() % 3 == 0) source += "\n# Foo ";
+    source += fragments[random() % count];
+  }
+  return source;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::cerr << "usage: section_index_test /path/to/resources" << std::endl;
+    return 1;
+  }
+  namespace fs = std::filesystem;
+  bool ok = true;
+  bool scanned = false;
+  for (auto&& entry : fs::directory_iterator(argv[1])) {
+    const fs::path& path = entry.path();
+    if (path.extension() != ".md") continue;
+    std::ifstream ifs(path, std::ios::binary);
+    const std::string source{std::istreambuf_iterator<char>(ifs),
+                             std::istreambuf_iterator<char>()};
+    ok = checkDocument(path.filename().string(), source, scanned) && ok;
+  }
+
+  const char* const cases[] = {
+      "#    # code\n",
+      "## # a\n\ntext\n# b\n",
+      "> # Foo\n\n# Foo\n",
+      "- # Foo\n1. # Foo\n# Foo\n",
+      "```cpp\n# not a heading\n```\n# Heading\n",
+      "`code\n# inside\nend`\n# after\n",
+      "``a``\n# after\n",
+      "```\n# code\n```\n# after\n",
+      "- a\n    - # nested\n# top\n",
+      "> a\n>     - # quoted\n# top\n",
+      "# a `x` # b\n",
+      "a\r# b\n",
+      "# a\r\rtext\r## b\r# c\r",
+      "```\r# code\r```\r# after\r",
+  };
+  std::size_t scannedCases = 0;
+  for (const char* source : cases) {
+    ok = checkDocument("case", source, scanned) && ok;
+    scannedCases += scanned;
+  }
+
+  std::mt19937 random(20260101);
+  std::size_t scannedRandom = 0;
+  const std::size_t documents = 20000;
+  for (std::size_t i = 0; i < documents; ++i) {
+    const std::string source = randomDocument(random);
+    if (!checkDocument("random " + std::to_string(i), source, scanned)) {
+      ok = false;
+      break;
+    }
+    scannedRandom += scanned;
+  }
+  // the scan is what makes sections cheap, it must not give up on
+  // ordinary documents
+  if (scannedCases == 0 || scannedRandom < documents / 10) {
+    std::cerr << "[error] the scan was used for " << scannedCases
+              << " cases and " << scannedRandom << " random documents"
+              << std::endl;
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+// PlainTextRenderer and SummaryRenderer on a known document, and the
+// summary cut: at most `limit` code points including the "...", at a word
+// boundary, and never inside a multibyte character.
+#include <cstddef>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "parser/EventParser.hpp"
+#include "render/PlainTextRenderer.hpp"
+#include "render/SummaryRenderer.hpp"
+#include "tokenizer/Tokenizer.hpp"
+
+namespace {
+
+const std::string document =
+    "# Title\n"
+    "\n"
+    "Hello *world* and [a link](http://x)\n"
+    "over two lines. ![alt](i.png) `code`\n"
+    "\n"
+    "```\n"
+    "block code\n"
+    "```\n"
+    "\n"
+    "- item\n"
+    "\n"
+    "> quoted\n";
+
+std::string plainText(const std::string& source) {
+  m2h::Tokenizer tokenizer;
+  std::vector<m2h::Token> tokens =
+      tokenizer.tokenize(source.c_str(), source.size());
+  std::ostringstream ost;
+  m2h::PlainTextRenderer renderer(ost);
+  m2h::parseEvents(tokens, renderer);
+  return ost.str();
+}
+
+std::string summary(const std::string& source, std::size_t limit) {
+  m2h::Tokenizer tokenizer;
+  std::vector<m2h::Token> tokens =
+      tokenizer.tokenize(source.c_str(), source.size());
+  std::ostringstream ost;
+  m2h::SummaryRenderer renderer(ost, limit);
+  m2h::parseEvents(tokens, renderer);
+  renderer.finish();
+  return ost.str();
+}
+
+std::size_t codePoints(const std::string& s) {
+  std::size_t n = 0;
+  for (char c : s) n += (static_cast<unsigned char>(c) & 0xc0) != 0x80;
+  return n;
+}
+
+bool expect(const char* name, const std::string& found,
+            const std::string& expected) {
+  if (found == expected) return true;
+  std::cerr << "[error] " << name << ": '" << found << "' instead of '"
+            << expected << "'" << std::endl;
+  return false;
+}
+
+}  // namespace
+
+int main() {
+  bool ok = true;
+  // the line breaks follow the inline nodes, as in the html
+  ok = expect("plain text", plainText(document),
+              "Title\n\nHello world\n and a link\nover two lines. alt\n"
+              " code\n\nblock code\n\nitem\n\nquoted\n\n") &&
+       ok;
+  ok = expect("summary", summary(document, 200),
+              "Hello world and a link over two lines. code item quoted\n") &&
+       ok;
+
+  // exactly `limit` code points are not cut
+  ok = expect("exact fit", summary("one two three\n", 13),
+              "one two three\n") &&
+       ok;
+  ok = expect("cut at a word", summary("one two three four\n", 13),
+              "one two...\n") &&
+       ok;
+  ok = expect("cut before a space", summary("one two three four\n", 10),
+              "one two...\n") &&
+       ok;
+  ok = expect("single long word", summary("abcdefghijkl\n", 8),
+              "abcde...\n") &&
+       ok;
+
+  // two-byte characters around the limit
+  std::string accents;
+  for (int i = 0; i < 30; ++i) accents += "\xc3\xa9";
+  std::string five;
+  for (int i = 0; i < 5; ++i) five += "\xc3\xa9";
+  ok = expect("multibyte cut", summary(accents + "\n", 8), five + "...\n") &&
+       ok;
+  ok = expect("multibyte fit", summary(five + "\n", 5), five + "\n") && ok;
+  ok = expect("multibyte words",
+              summary(five + " " + accents + "\n", 12), five + "...\n") &&
+       ok;
+
+  // long documents: never more than `limit` code points
+  std::string words;
+  for (int i = 0; i < 200; ++i) words += "w\xc3\xb6rd" + std::to_string(i) + " ";
+  for (std::size_t limit = 3; limit < 120; ++limit) {
+    std::string found = summary(words + "\n", limit);
+    found.pop_back();  // the newline
+    if (codePoints(found) > limit ||
+        found.compare(found.size() - 3, 3, "...") != 0 ||
+        words.compare(0, found.size() - 3, found, 0, found.size() - 3) !=
+            0) {
+      std::cerr << "[error] limit " << limit << ": '" << found << "'"
+                << std::endl;
+      ok = false;
+    }
+  }
+  return ok ? 0 : 1;
+}
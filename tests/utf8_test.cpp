@@ -0,0 +1,125 @@
+// Utf8Sink and sanitizeUtf8 in both modes: Latin-1 input, NUL bytes and
+// multibyte sequences split across read chunks at every point must be
+// rejected at the right offset or repaired with the right number of
+// U+FFFD, and the files in resources/ must pass unchanged.
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "io/Utf8.hpp"
+
+namespace {
+
+const std::string fffd = m2h::Utf8Sink::replacement;
+
+struct Case {
+  const char* name;
+  std::string input;
+  std::string repaired;    // the output of Utf8Mode::Repair
+  std::uint64_t replaced;  // U+FFFD written by Utf8Mode::Repair
+  std::uint64_t offset;    // of the InvalidInput of Utf8Mode::Reject
+  const char* error;       // its message without the offset
+};
+
+// Feeds `input` to a sink in two chunks split at `split`.
+std::string sink(const std::string& input, std::size_t split,
+                 m2h::Utf8Mode mode, std::uint64_t& replaced) {
+  std::string out;
+  m2h::Utf8Sink sink(out, mode);
+  sink.append(input.data(), split);
+  sink.append(input.data() + split, input.size() - split);
+  sink.finish();
+  replaced = sink.replaced();
+  return out;
+}
+
+bool checkCase(const Case& c) {
+  bool ok = true;
+  auto fail = [&](std::size_t split, const std::string& what) {
+    std::cerr << "[error] " << c.name << " split at " << split << ": "
+              << what << std::endl;
+    ok = false;
+  };
+  const std::string error =
+      std::string(c.error) + " at byte " + std::to_string(c.offset);
+  for (std::size_t split = 0; split <= c.input.size(); ++split) {
+    std::uint64_t replaced = 0;
+    const std::string repaired =
+        sink(c.input, split, m2h::Utf8Mode::Repair, replaced);
+    if (repaired != c.repaired || replaced != c.replaced) {
+      fail(split, "repaired to " + std::to_string(repaired.size()) +
+                      " bytes with " + std::to_string(replaced) +
+                      " replacements");
+    }
+    try {
+      sink(c.input, split, m2h::Utf8Mode::Reject, replaced);
+      if (c.replaced != 0) fail(split, "not rejected");
+    } catch (const m2h::InvalidInput& e) {
+      if (c.replaced == 0 || e.offset() != c.offset || e.what() != error) {
+        fail(split, std::string("rejected with '") + e.what() + "'");
+      }
+    }
+  }
+
+  std::string text = c.input;
+  if (m2h::sanitizeUtf8(text, m2h::Utf8Mode::Repair) != c.replaced ||
+      text != c.repaired) {
+    fail(c.input.size(), "sanitizeUtf8 repaired it differently");
+  }
+  return ok;
+}
+
+bool checkResources(const char* directory) {
+  namespace fs = std::filesystem;
+  bool ok = true;
+  for (auto&& entry : fs::directory_iterator(directory)) {
+    const fs::path& path = entry.path();
+    if (path.extension() != ".md") continue;
+    std::ifstream ifs(path, std::ios::binary);
+    const std::string source{std::istreambuf_iterator<char>(ifs),
+                             std::istreambuf_iterator<char>()};
+    std::string text = source;
+    try {
+      m2h::sanitizeUtf8(text, m2h::Utf8Mode::Reject);
+    } catch (const m2h::InvalidInput& e) {
+      std::cerr << "[error] " << path.filename().string() << ": " << e.what()
+                << std::endl;
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::cerr << "usage: utf8_test /path/to/resources" << std::endl;
+    return 1;
+  }
+  const std::string nul(1, '\0');
+  const Case cases[] = {
+      {"ascii", "# plain text\n", "# plain text\n", 0, 0, ""},
+      {"multibyte", "\xc3\xa9t\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80\n",
+       "\xc3\xa9t\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80\n", 0, 0, ""},
+      // "déjà vu" in Latin-1: each accented letter is a lone lead byte
+      {"latin-1", "d\xe9j\xe0 vu", "d" + fffd + "j" + fffd + " vu", 2, 1,
+       "invalid UTF-8"},
+      {"nul", "a" + nul + "b" + nul, "a" + fffd + "b" + fffd, 2, 1,
+       "NUL byte"},
+      // a four-byte sequence cut short by the end of the input
+      {"truncated", "ab\xf0\x9f\x98", "ab" + fffd, 1, 2, "invalid UTF-8"},
+      // the lead byte of a three-byte sequence followed by ASCII
+      {"interrupted", "x\xe2\x82y", "x" + fffd + "y", 1, 1, "invalid UTF-8"},
+      {"overlong", "\xc0\xaf!", fffd + fffd + "!", 2, 0, "invalid UTF-8"},
+      {"surrogate", "\xed\xa0\x80", fffd + fffd + fffd, 3, 0,
+       "invalid UTF-8"},
+  };
+  bool ok = true;
+  for (auto&& c : cases) ok = checkCase(c) && ok;
+  ok = checkResources(argv[1]) && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+// Runs `main.bin --watch` on a temporary directory and goes through one
+// convert-on-change cycle: the first conversion, a rebuild after an edit,
+// a new file and a removed one must each show up in the output directory.
+// Exits 77 (skipped) where inotify is not available.
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#include "io/DirectoryWatcher.hpp"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+std::string readFile(const fs::path& path) {
+  std::ifstream ifs(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(ifs),
+          std::istreambuf_iterator<char>()};
+}
+
+void writeFile(const fs::path& path, const std::string& content) {
+  std::ofstream ofs(path, std::ios::binary);
+  ofs << content;
+}
+
+// Polls `done` for up to ten seconds, or until `child` exits.
+bool waitFor(pid_t child, const std::function<bool()>& done) {
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (done()) return true;
+    int status;
+    if (::waitpid(child, &status, WNOHANG) == child) return done();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return done();
+}
+
+bool contains(const fs::path& path, const std::string& what) {
+  return readFile(path).find(what) != std::string::npos;
+}
+
+bool check(bool ok, const std::string& what) {
+  if (!ok) std::cerr << "[error] watch: " << what << std::endl;
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::cerr << "usage: watch_test /path/to/main.bin" << std::endl;
+    return 1;
+  }
+  const fs::path root = fs::temp_directory_path() /
+                        ("m2h_watch_test_" + std::to_string(::getpid()));
+  const fs::path input = root / "in", output = root / "out";
+  fs::remove_all(root);
+  fs::create_directories(input);
+  if (!m2h::DirectoryWatcher(input.string())) {
+    std::cout << "[info] inotify is not available" << std::endl;
+    fs::remove_all(root);
+    return 77;
+  }
+  writeFile(input / "a.md", "# first\n");
+
+  const std::string watchOption = "--watch=" + output.string();
+  const pid_t child = ::fork();
+  if (child == 0) {
+    std::freopen("/dev/null", "w", stdout);
+    ::execl(argv[1], argv[1], watchOption.c_str(), "--debounce=10",
+            input.c_str(), static_cast<char*>(nullptr));
+    ::_exit(127);
+  }
+
+  bool ok = check(waitFor(child,
+                          [&] {
+                            return contains(output / "a.html",
+                                            "<h1>first</h1>");
+                          }),
+                  "a.md was not converted at start");
+  if (ok) {
+    writeFile(input / "a.md", "# second\n");
+    ok = check(waitFor(child,
+                       [&] {
+                         return contains(output / "a.html",
+                                         "<h1>second</h1>");
+                       }),
+               "a.md was not rebuilt after an edit");
+  }
+  if (ok) {
+    writeFile(input / "b.md", "new *file*\n");
+    ok = check(waitFor(child,
+                       [&] {
+                         return contains(output / "b.html",
+                                         "<em>file</em>");
+                       }),
+               "the new b.md was not converted");
+  }
+  if (ok) {
+    fs::remove(input / "a.md");
+    ok = check(waitFor(child,
+                       [&] { return !fs::exists(output / "a.html"); }),
+               "a.html was not removed with a.md");
+  }
+
+  ::kill(child, SIGTERM);
+  ::waitpid(child, nullptr, 0);
+  fs::remove_all(root);
+  return ok ? 0 : 1;
+}